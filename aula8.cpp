@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define TAM_BLOCO (1 << 20)  // Bytes lidos por chamada ao carregar arquivos
+#define MAGICO_INDICE 0x41524131  // Identifica arquivos gerados por salvarIndice
+
 typedef struct {
     int RA;
     char nome[50];
@@ -9,66 +12,424 @@ typedef struct {
     float notas[4];
 } Aluno;
 
-typedef struct stNo {
-    Aluno aluno;
-    struct stNo *esquerda;
-    struct stNo *direita;
+// No do indice: so a chave e indices, para que a descida por RA percorra
+// nos pequenos e contiguos. O registro completo fica no pool de alunos.
+typedef struct {
+    int RA;
+    int aluno;      // Indice do registro em tArvore.alunos
+    int esquerda;   // Indice do filho em tArvore.nos, -1 se nao houver
+    int direita;
 } tNo;
 
-tNo* inserirAluno(tNo *raiz, tNo *no, Aluno aluno) {
-    if (!no) {
-        no = (tNo *) malloc(sizeof(tNo));
-        if (!no) {
+// Arena de nos e pool de registros. Crescem por realloc, por isso os
+// filhos sao guardados como indices e nao como ponteiros.
+typedef struct {
+    tNo *nos;
+    int numNos, capNos;
+    Aluno *alunos;
+    int numAlunos, capAlunos;
+    int raiz;
+} tArvore;
+
+void iniciarArvore(tArvore *arv) {
+    arv->nos = NULL;
+    arv->numNos = arv->capNos = 0;
+    arv->alunos = NULL;
+    arv->numAlunos = arv->capAlunos = 0;
+    arv->raiz = -1;
+}
+
+void *crescer(void *vetor, int *cap, size_t tamElemento) {
+    *cap = *cap ? *cap * 2 : 64;
+    vetor = realloc(vetor, *cap * tamElemento);
+    if (!vetor) {
+        printf("Sem memoria\n");
+        exit(1);
+    }
+    return vetor;
+}
+
+int novoNo(tArvore *arv, Aluno aluno) {
+    if (arv->numNos == arv->capNos)
+        arv->nos = (tNo *) crescer(arv->nos, &arv->capNos, sizeof(tNo));
+    if (arv->numAlunos == arv->capAlunos)
+        arv->alunos = (Aluno *) crescer(arv->alunos, &arv->capAlunos, sizeof(Aluno));
+
+    arv->alunos[arv->numAlunos] = aluno;
+
+    tNo *no = &arv->nos[arv->numNos];
+    no->RA = aluno.RA;
+    no->aluno = arv->numAlunos++;
+    no->esquerda = -1;
+    no->direita = -1;
+    return arv->numNos++;
+}
+
+void inserirAluno(tArvore *arv, Aluno aluno) {
+    int novo = novoNo(arv, aluno);
+
+    if (arv->raiz == -1) {
+        arv->raiz = novo;
+        return;
+    }
+
+    int atual = arv->raiz;
+    while (1) {
+        tNo *no = &arv->nos[atual];
+        int *filho = (aluno.RA < no->RA) ? &no->esquerda : &no->direita;
+        if (*filho == -1) {
+            *filho = novo;
+            return;
+        }
+        atual = *filho;
+    }
+}
+
+void print_arvore(tArvore *arv, int no, int espaco) {
+    if (no == -1) return;
+
+    print_arvore(arv, arv->nos[no].direita, espaco + 1);
+
+    for (int i = 0; i < espaco; i++)
+        printf("   ");
+    printf("%d\n", arv->nos[no].RA);
+
+    print_arvore(arv, arv->nos[no].esquerda, espaco + 1);
+}
+
+// Nos e registros estao em dois blocos: liberar a arvore e O(1)
+void desalocar_arvore(tArvore *arv) {
+    free(arv->nos);
+    free(arv->alunos);
+    iniciarArvore(arv);
+}
+
+Aluno* buscarAluno(tArvore *arv, int RA) {
+    int atual = arv->raiz;
+    while (atual != -1) {
+        tNo *no = &arv->nos[atual];
+        if (RA == no->RA)
+            return &arv->alunos[no->aluno];
+        atual = (RA < no->RA) ? no->esquerda : no->direita;
+    }
+    return NULL;
+}
+
+void adicionarRegistro(tArvore *arv, Aluno aluno) {
+    if (arv->numAlunos == arv->capAlunos)
+        arv->alunos = (Aluno *) crescer(arv->alunos, &arv->capAlunos, sizeof(Aluno));
+    arv->alunos[arv->numAlunos++] = aluno;
+}
+
+typedef struct {
+    int RA;
+    int aluno;
+} tChave;
+
+int comparaChave(const void *a, const void *b) {
+    const tChave *x = (const tChave *) a;
+    const tChave *y = (const tChave *) b;
+    if (x->RA != y->RA)
+        return (x->RA > y->RA) - (x->RA < y->RA);
+    return x->aluno - y->aluno;
+}
+
+int montarBalanceado(tArvore *arv, tChave *chaves, int ini, int fim) {
+    if (ini > fim)
+        return -1;
+
+    int meio = ini + (fim - ini) / 2;
+    int no = arv->numNos++;
+    arv->nos[no].RA = chaves[meio].RA;
+    arv->nos[no].aluno = chaves[meio].aluno;
+    arv->nos[no].esquerda = montarBalanceado(arv, chaves, ini, meio - 1);
+    arv->nos[no].direita = montarBalanceado(arv, chaves, meio + 1, fim);
+    return no;
+}
+
+// Refaz o indice inteiro como arvore balanceada sobre todos os registros
+// do pool: ordena os RAs uma vez e monta a arvore pelo meio, O(n log n).
+// Registros com o mesmo RA ficam todos no indice, o mais antigo primeiro.
+void construirIndice(tArvore *arv) {
+    int n = arv->numAlunos;
+    tChave *chaves = (tChave *) malloc((n ? n : 1) * sizeof(tChave));
+    if (!chaves) {
+        printf("Sem memoria\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        chaves[i].RA = arv->alunos[i].RA;
+        chaves[i].aluno = i;
+    }
+    qsort(chaves, n, sizeof(tChave), comparaChave);
+
+    if (arv->capNos < n) {
+        free(arv->nos);
+        arv->capNos = n;
+        arv->nos = (tNo *) malloc(n * sizeof(tNo));
+        if (!arv->nos) {
             printf("Sem memoria\n");
             exit(1);
         }
-        no->aluno = aluno;
-        no->esquerda = NULL;
-        no->direita = NULL;
+    }
+    arv->numNos = 0;
+    arv->raiz = montarBalanceado(arv, chaves, 0, n - 1);
+    free(chaves);
+}
+
+// Separa o proximo campo de *cursor, terminando-o no separador. Campos
+// vazios continuam sendo campos, entao as colunas nao se deslocam.
+// Devolve NULL quando a linha acabou.
+char *proximoCampo(char **cursor, char separador) {
+    char *campo = *cursor;
+    if (!campo)
+        return NULL;
+
+    char *fim = strchr(campo, separador);
+    if (fim) {
+        *fim = '\0';
+        *cursor = fim + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return campo;
+}
+
+// Le uma linha "RA;nome;idade;nota1;nota2;nota3;nota4" separada por
+// separador (';' ou ','), que carregarCSV escolhe uma vez por arquivo
+int lerLinhaCSV(char *linha, char separador, Aluno *aluno) {
+    char *cursor = linha;
+    char *campo = proximoCampo(&cursor, separador);
+    if (!campo || sscanf(campo, "%d", &aluno->RA) != 1)
+        return 0;
 
-        if (!raiz)
-            return no;
+    campo = proximoCampo(&cursor, separador);
+    if (!campo)
+        return 0;
+    strncpy(aluno->nome, campo, sizeof(aluno->nome) - 1);
+    aluno->nome[sizeof(aluno->nome) - 1] = '\0';
 
-        if (aluno.RA < raiz->aluno.RA)
-            raiz->esquerda = no;
-        else
-            raiz->direita = no;
+    campo = proximoCampo(&cursor, separador);
+    if (!campo || sscanf(campo, "%d", &aluno->idade) != 1)
+        return 0;
 
-        return no;
+    for (int i = 0; i < 4; i++) {
+        campo = proximoCampo(&cursor, separador);
+        if (!campo || sscanf(campo, "%f", &aluno->notas[i]) != 1)
+            return 0;
+    }
+    return 1;
+}
+
+// Carrega alunos de um CSV lendo blocos grandes, e refaz o indice.
+// Linhas que nao seguem o formato (como um cabecalho) sao ignoradas.
+int carregarCSV(tArvore *arv, const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "rb");
+    if (!arquivo) {
+        perror("Erro ao abrir o arquivo");
+        return 0;
+    }
+
+    char *bloco = (char *) malloc(TAM_BLOCO + 1);
+    if (!bloco) {
+        printf("Sem memoria\n");
+        exit(1);
+    }
+
+    int carregados = 0;
+    size_t pendente = 0;  // Inicio de linha incompleta guardado do bloco anterior
+    char separador = 0;   // ';' se a primeira linha tiver um, senao ','
+    while (1) {
+        size_t lidos = fread(bloco + pendente, 1, TAM_BLOCO - pendente, arquivo);
+        size_t fim = pendente + lidos;
+        bloco[fim] = '\0';
+
+        char *linha = bloco;
+        if (!separador && fim > 0) {
+            char *quebra = strchr(bloco, '\n');
+            char *pontoEVirgula = strchr(bloco, ';');
+            separador = (pontoEVirgula && (!quebra || pontoEVirgula < quebra)) ? ';' : ',';
+        }
+
+        char *quebra;
+        while ((quebra = strchr(linha, '\n')) != NULL) {
+            *quebra = '\0';
+            Aluno aluno;
+            if (lerLinhaCSV(linha, separador, &aluno)) {
+                adicionarRegistro(arv, aluno);
+                carregados++;
+            }
+            linha = quebra + 1;
+        }
+
+        pendente = fim - (linha - bloco);
+        if (lidos == 0 || pendente == TAM_BLOCO) {
+            // Fim do arquivo sem '\n' final, ou linha maior que o bloco
+            Aluno aluno;
+            if (lerLinhaCSV(linha, separador, &aluno)) {
+                adicionarRegistro(arv, aluno);
+                carregados++;
+            }
+            pendente = 0;
+            if (lidos == 0)
+                break;
+        }
+        memmove(bloco, linha, pendente);
     }
 
-    if (aluno.RA < no->aluno.RA)
-        return inserirAluno(no, no->esquerda, aluno);
-    else
-        return inserirAluno(no, no->direita, aluno);
+    free(bloco);
+    fclose(arquivo);
+    construirIndice(arv);
+    return carregados;
 }
 
-void print_arvore(tNo *no, int espaco) {
-    if (!no) return;
+// Carrega um arquivo de registros Aluno gravados em binario direto no pool
+int carregarBinario(tArvore *arv, const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "rb");
+    if (!arquivo) {
+        perror("Erro ao abrir o arquivo");
+        return 0;
+    }
 
-    print_arvore(no->direita, espaco + 1);
+    int carregados = 0;
+    size_t lidos;
+    do {
+        while (arv->capAlunos - arv->numAlunos < TAM_BLOCO / (int) sizeof(Aluno))
+            arv->alunos = (Aluno *) crescer(arv->alunos, &arv->capAlunos, sizeof(Aluno));
+        lidos = fread(arv->alunos + arv->numAlunos, sizeof(Aluno), TAM_BLOCO / sizeof(Aluno), arquivo);
+        arv->numAlunos += lidos;
+        carregados += lidos;
+    } while (lidos > 0);
 
-    for (int i = 0; i < espaco; i++)
-        printf("   ");
-    printf("%d\n", no->aluno.RA);
+    fclose(arquivo);
+    construirIndice(arv);
+    return carregados;
+}
+
+typedef struct {
+    int magico;
+    int numAlunos;
+    int numNos;
+    int raiz;
+} tCabecalho;
+
+// Grava pool e indice como estao na memoria, para abrirIndice recarregar
+// sem reordenar nem reconstruir nada
+int salvarIndice(tArvore *arv, const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "wb");
+    if (!arquivo) {
+        perror("Erro ao criar o arquivo");
+        return 0;
+    }
 
-    print_arvore(no->esquerda, espaco + 1);
+    tCabecalho cab = {MAGICO_INDICE, arv->numAlunos, arv->numNos, arv->raiz};
+    int ok = fwrite(&cab, sizeof(cab), 1, arquivo) == 1 &&
+             fwrite(arv->alunos, sizeof(Aluno), arv->numAlunos, arquivo) == (size_t) arv->numAlunos &&
+             fwrite(arv->nos, sizeof(tNo), arv->numNos, arquivo) == (size_t) arv->numNos;
+
+    fclose(arquivo);
+    return ok;
 }
 
-void desalocar_arvore(tNo *no) {
-    if (no) {
-        desalocar_arvore(no->esquerda);
-        desalocar_arvore(no->direita);
-        free(no);
+// Confere os indices lidos de um arquivo antes de usa-los: raiz e filhos
+// devem ser -1 ou um no existente, cada aluno um registro existente, e
+// nenhum no pode ser filho de dois pais nem da propria raiz, senao a
+// descida por RA sairia dos vetores ou entraria em ciclo
+int indiceValido(tNo *nos, int numNos, int numAlunos, int raiz) {
+    if (raiz < -1 || raiz >= numNos || (raiz == -1 && numNos > 0))
+        return 0;
+
+    char *temPai = (char *) calloc(numNos ? numNos : 1, 1);
+    if (!temPai) {
+        printf("Sem memoria\n");
+        exit(1);
+    }
+
+    int ok = 1;
+    for (int i = 0; i < numNos && ok; i++) {
+        int filhos[2] = {nos[i].esquerda, nos[i].direita};
+        if (nos[i].aluno < 0 || nos[i].aluno >= numAlunos)
+            ok = 0;
+        for (int j = 0; j < 2 && ok; j++) {
+            int filho = filhos[j];
+            if (filho == -1)
+                continue;
+            if (filho < 0 || filho >= numNos || filho == raiz || temPai[filho])
+                ok = 0;
+            else
+                temPai[filho] = 1;
+        }
+    }
+
+    free(temPai);
+    return ok;
+}
+
+// Substitui a arvore pelo conteudo de um arquivo gerado por salvarIndice
+int abrirIndice(tArvore *arv, const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "rb");
+    if (!arquivo) {
+        perror("Erro ao abrir o arquivo");
+        return 0;
+    }
+
+    // Os tamanhos do cabecalho tem que bater com o arquivo antes de alocar,
+    // para um cabecalho corrompido nao pedir memoria sem fim
+    tCabecalho cab;
+    long tamanho = -1;
+    if (fseek(arquivo, 0, SEEK_END) == 0) {
+        tamanho = ftell(arquivo);
+        rewind(arquivo);
+    }
+    if (fread(&cab, sizeof(cab), 1, arquivo) != 1 || cab.magico != MAGICO_INDICE ||
+        cab.numAlunos < 0 || cab.numNos < 0 ||
+        (long long) sizeof(tCabecalho) + cab.numAlunos * (long long) sizeof(Aluno) +
+        cab.numNos * (long long) sizeof(tNo) != tamanho) {
+        printf("Arquivo de indice invalido\n");
+        fclose(arquivo);
+        return 0;
+    }
+
+    desalocar_arvore(arv);
+    arv->capAlunos = cab.numAlunos;
+    arv->capNos = cab.numNos;
+    arv->alunos = (Aluno *) malloc((cab.numAlunos ? cab.numAlunos : 1) * sizeof(Aluno));
+    arv->nos = (tNo *) malloc((cab.numNos ? cab.numNos : 1) * sizeof(tNo));
+    if (!arv->alunos || !arv->nos) {
+        printf("Sem memoria\n");
+        exit(1);
     }
+
+    int ok = fread(arv->alunos, sizeof(Aluno), cab.numAlunos, arquivo) == (size_t) cab.numAlunos &&
+             fread(arv->nos, sizeof(tNo), cab.numNos, arquivo) == (size_t) cab.numNos;
+    fclose(arquivo);
+
+    if (!ok) {
+        printf("Arquivo de indice incompleto\n");
+        desalocar_arvore(arv);
+        return 0;
+    }
+    if (!indiceValido(arv->nos, cab.numNos, cab.numAlunos, cab.raiz)) {
+        printf("Arquivo de indice corrompido\n");
+        desalocar_arvore(arv);
+        return 0;
+    }
+    arv->numAlunos = cab.numAlunos;
+    arv->numNos = cab.numNos;
+    arv->raiz = cab.raiz;
+    return 1;
 }
 
 int main() {
-    tNo *raiz = NULL;
-    int opcao;
+    tArvore arvore;
+    int opcao, RA;
+    char nomeArquivo[256];
+
+    iniciarArvore(&arvore);
 
     do {
-        printf("\n1 - Inserir aluno\n2 - Exibir arvore (RAs)\n0 - Sair\nEscolha: ");
+        printf("\n1 - Inserir aluno\n2 - Exibir arvore (RAs)\n3 - Carregar CSV\n4 - Carregar arquivo binario\n"
+               "5 - Salvar indice\n6 - Abrir indice\n7 - Buscar aluno por RA\n0 - Sair\nEscolha: ");
         scanf("%d", &opcao);
 
         if (opcao == 1) {
@@ -86,18 +447,38 @@ int main() {
                 scanf("%f", &aluno.notas[i]);
             }
 
-            if (!raiz)
-                raiz = inserirAluno(raiz, raiz, aluno);
-            else
-                inserirAluno(raiz, raiz, aluno);
+            inserirAluno(&arvore, aluno);
 
         } else if (opcao == 2) {
             printf("\nArvore de RAs:\n");
-            print_arvore(raiz, 0);
+            print_arvore(&arvore, arvore.raiz, 0);
+
+        } else if (opcao >= 3 && opcao <= 6) {
+            printf("Arquivo: ");
+            scanf("%255s", nomeArquivo);
+
+            if (opcao == 3)
+                printf("%d aluno(s) carregado(s)\n", carregarCSV(&arvore, nomeArquivo));
+            else if (opcao == 4)
+                printf("%d aluno(s) carregado(s)\n", carregarBinario(&arvore, nomeArquivo));
+            else if (opcao == 5)
+                printf(salvarIndice(&arvore, nomeArquivo) ? "Indice salvo\n" : "Falha ao salvar\n");
+            else if (abrirIndice(&arvore, nomeArquivo))
+                printf("%d aluno(s) no indice\n", arvore.numAlunos);
+
+        } else if (opcao == 7) {
+            printf("RA: ");
+            scanf("%d", &RA);
+            Aluno *aluno = buscarAluno(&arvore, RA);
+            if (aluno)
+                printf("%s, %d anos, notas %.1f %.1f %.1f %.1f\n", aluno->nome, aluno->idade,
+                       aluno->notas[0], aluno->notas[1], aluno->notas[2], aluno->notas[3]);
+            else
+                printf("RA %d nao encontrado\n", RA);
         }
 
     } while (opcao != 0);
 
-    desalocar_arvore(raiz);
+    desalocar_arvore(&arvore);
     return 0;
 }
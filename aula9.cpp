@@ -14,12 +14,33 @@ typedef struct stNo {
     struct stNo *esquerda;
     struct stNo *direita;
     int fb;
+    int altura;
+    int tam;
 } tNo;
 
+int altura(tNo *no) {
+    return no ? no->altura : 0;
+}
+
+int tamanho(tNo *no) {
+    return no ? no->tam : 0;
+}
+
+// Recalcula altura, fator de balanceamento e tamanho da subarvore a partir dos filhos
+void atualizaNo(tNo *no) {
+    int he = altura(no->esquerda);
+    int hd = altura(no->direita);
+    no->altura = max(he, hd) + 1;
+    no->fb = hd - he;
+    no->tam = tamanho(no->esquerda) + tamanho(no->direita) + 1;
+}
+
 tNo* rotacaoDireita(tNo *p) {
     tNo *q = p->esquerda;
     p->esquerda = q->direita;
     q->direita = p;
+    atualizaNo(p);
+    atualizaNo(q);
     return q;
 }
 
@@ -27,6 +48,8 @@ tNo* rotacaoEsquerda(tNo *p) {
     tNo *q = p->direita;
     p->direita = q->esquerda;
     q->esquerda = p;
+    atualizaNo(p);
+    atualizaNo(q);
     return q;
 }
 
@@ -43,35 +66,32 @@ tNo* balancear(tNo *p) {
     return p;
 }
 
-int atualizaFatBal(tNo **no) {
-    int he, hd;
-    if (*no == NULL)
-        return 0;
-    he = atualizaFatBal(&(*no)->esquerda);
-    hd = atualizaFatBal(&(*no)->direita);
-    (*no)->fb = hd - he;
-    if (abs((*no)->fb) >= 2) {
-        *no = balancear(*no);
-        he = atualizaFatBal(&(*no)->esquerda);
-        hd = atualizaFatBal(&(*no)->direita);
-        (*no)->fb = hd - he;
+// Atualiza um no do caminho de insercao/remocao e rotaciona se ficou desbalanceado
+tNo* rebalancear(tNo *no) {
+    atualizaNo(no);
+    if (abs(no->fb) >= 2)
+        no = balancear(no);
+    return no;
+}
+
+tNo* criarNo(int info) {
+    tNo *novo = (tNo *) malloc(sizeof(tNo));
+    if (!novo) {
+        printf("Sem memoria\n");
+        exit(1);
     }
-    return max(hd, he) + 1;
+    novo->info = info;
+    novo->esquerda = NULL;
+    novo->direita = NULL;
+    novo->fb = 0;
+    novo->altura = 1;
+    novo->tam = 1;
+    return novo;
 }
 
 tNo* inserirNo(tNo *raiz, int info) {
-    if (!raiz) {
-        tNo *novo = (tNo *) malloc(sizeof(tNo));
-        if (!novo) {
-            printf("Sem memoria\n");
-            exit(1);
-        }
-        novo->info = info;
-        novo->esquerda = NULL;
-        novo->direita = NULL;
-        novo->fb = 0;
-        return novo;
-    }
+    if (!raiz)
+        return criarNo(info);
 
     if (info == raiz->info) {
         return raiz;
@@ -81,8 +101,108 @@ tNo* inserirNo(tNo *raiz, int info) {
     else
         raiz->direita = inserirNo(raiz->direita, info);
 
-    return raiz;
+    return rebalancear(raiz);
+}
+
+tNo* removerNo(tNo *raiz, int info) {
+    if (!raiz)
+        return NULL;
+
+    if (info < raiz->info)
+        raiz->esquerda = removerNo(raiz->esquerda, info);
+    else if (info > raiz->info)
+        raiz->direita = removerNo(raiz->direita, info);
+    else {
+        if (!raiz->esquerda || !raiz->direita) {
+            tNo *filho = raiz->esquerda ? raiz->esquerda : raiz->direita;
+            free(raiz);
+            return filho;
+        }
+
+        // Dois filhos: o sucessor (menor da direita) toma o lugar do no
+        tNo *sucessor = raiz->direita;
+        while (sucessor->esquerda)
+            sucessor = sucessor->esquerda;
+        raiz->info = sucessor->info;
+        raiz->direita = removerNo(raiz->direita, sucessor->info);
+    }
+
+    return rebalancear(raiz);
+}
+
+// Monta uma arvore perfeitamente balanceada com v[ini..fim], que deve estar
+// em ordem crescente e sem repeticoes. Cada elemento vira um no: O(n).
+tNo* construirBalanceada(int *v, int ini, int fim) {
+    if (ini > fim)
+        return NULL;
+
+    int meio = ini + (fim - ini) / 2;
+    tNo *no = criarNo(v[meio]);
+    no->esquerda = construirBalanceada(v, ini, meio - 1);
+    no->direita = construirBalanceada(v, meio + 1, fim);
+    atualizaNo(no);
+    return no;
+}
+
+// Visita em ordem os valores em [lo, hi], descendo apenas nas subarvores
+// que podem conter valores do intervalo. Retorna quantos foram visitados.
+int buscaIntervalo(tNo *no, int lo, int hi, void (*visita)(int)) {
+    if (!no)
+        return 0;
+
+    int total = 0;
+    if (lo < no->info)
+        total += buscaIntervalo(no->esquerda, lo, hi, visita);
+    if (lo <= no->info && no->info <= hi) {
+        visita(no->info);
+        total++;
+    }
+    if (no->info < hi)
+        total += buscaIntervalo(no->direita, lo, hi, visita);
+    return total;
+}
+
+// Posicao (1 = menor) de info na ordem crescente, ou 0 se nao estiver na arvore
+int posicao(tNo *raiz, int info) {
+    int antes = 0;
+    while (raiz) {
+        if (info < raiz->info)
+            raiz = raiz->esquerda;
+        else if (info > raiz->info) {
+            antes += tamanho(raiz->esquerda) + 1;
+            raiz = raiz->direita;
+        } else
+            return antes + tamanho(raiz->esquerda) + 1;
+    }
+    return 0;
+}
+
+// k-esimo menor valor (k comeca em 1), ou NULL se k estiver fora da arvore
+tNo* selecionar(tNo *raiz, int k) {
+    while (raiz) {
+        int esq = tamanho(raiz->esquerda);
+        if (k <= esq)
+            raiz = raiz->esquerda;
+        else if (k == esq + 1)
+            return raiz;
+        else {
+            k -= esq + 1;
+            raiz = raiz->direita;
+        }
+    }
+    return NULL;
+}
+
+int comparaInt(const void *a, const void *b) {
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+void imprimeValor(int info) {
+    printf("%d ", info);
 }
+
 void print_arvore(tNo *no, int espaco) {
     if (!no) return;
 
@@ -141,10 +261,10 @@ void desalocar_arvore(tNo *no) {
 
 int main() {
     tNo *raiz = NULL;
-    int opcao, num;
+    int opcao, num, lo, hi;
 
     do {
-        printf("\n1 - Inserir numero\n2 - Exibir arvore\n3 - Exportar para DOT\n0 - Sair\nEscolha: ");
+        printf("\n1 - Inserir numero\n2 - Exibir arvore\n3 - Exportar para DOT\n4 - Remover numero\n5 - Construir a partir de vetor\n6 - Buscar intervalo\n7 - Posicao de um numero\n8 - k-esimo menor\n0 - Sair\nEscolha: ");
         scanf("%d", &opcao);
 
         if (opcao == 1) {
@@ -153,11 +273,7 @@ int main() {
                 scanf("%d", &num);
                 if (num == 0)
                     break;
-                if (!raiz)
-                    raiz = inserirNo(raiz, num);
-                else
-                    inserirNo(raiz, num);
-                atualizaFatBal(&raiz);
+                raiz = inserirNo(raiz, num);
             } while (num != 0);
         }
 
@@ -170,6 +286,64 @@ int main() {
             exportarParaDot(raiz, "arvore.dot");
         }
 
+        else if (opcao == 4) {
+            printf("Numero a remover: ");
+            scanf("%d", &num);
+            raiz = removerNo(raiz, num);
+        }
+
+        else if (opcao == 5) {
+            printf("Quantidade de numeros: ");
+            scanf("%d", &num);
+            if (num <= 0)
+                continue;
+            int *v = (int *) malloc(num * sizeof(int));
+            if (!v) {
+                printf("Sem memoria\n");
+                exit(1);
+            }
+            for (int i = 0; i < num; i++)
+                scanf("%d", &v[i]);
+
+            // Ordena e remove repetidos antes de montar a arvore
+            qsort(v, num, sizeof(int), comparaInt);
+            int n = 0;
+            for (int i = 0; i < num; i++)
+                if (n == 0 || v[i] != v[n - 1])
+                    v[n++] = v[i];
+
+            desalocar_arvore(raiz);
+            raiz = construirBalanceada(v, 0, n - 1);
+            free(v);
+        }
+
+        else if (opcao == 6) {
+            printf("Inicio e fim do intervalo: ");
+            scanf("%d %d", &lo, &hi);
+            int total = buscaIntervalo(raiz, lo, hi, imprimeValor);
+            printf("\n%d numero(s) no intervalo\n", total);
+        }
+
+        else if (opcao == 7) {
+            printf("Numero: ");
+            scanf("%d", &num);
+            int pos = posicao(raiz, num);
+            if (pos)
+                printf("%d e o %d-esimo menor\n", num, pos);
+            else
+                printf("%d nao esta na arvore\n", num);
+        }
+
+        else if (opcao == 8) {
+            printf("k: ");
+            scanf("%d", &num);
+            tNo *no = selecionar(raiz, num);
+            if (no)
+                printf("O %d-esimo menor e %d\n", num, no->info);
+            else
+                printf("Arvore tem menos de %d numeros\n", num);
+        }
+
     } while (opcao != 0);
 
     desalocar_arvore(raiz);
@@ -2,40 +2,268 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#if __cplusplus >= 202002L
+#include <coroutine>
+#endif
 
 #define MAX_CHILDREN 256  // For ASCII characters
+#define MAX_KEY_LENGTH 1000  // Assume keys won't exceed 1000 characters
+#define RADIX_VALUE_CHUNK 1024  // Interned values per storage chunk
+#define RADIX_NO_VALUE_ID UINT32_MAX  // ID of values that are not interned
+#define RADIX_GLOB_MAX 255  // Most tokens in a pattern, stars and characters
+#define RADIX_GLOB_WORDS ((RADIX_GLOB_MAX + 1 + 63) / 64)  // Words in a set of pattern positions
+#define RADIX_CLOCK_STEPS 8  // Most clock hand moves an insert makes to get back under budget
+#define RADIX_LOG_CAPACITY 4096  // Updates a replicated tree's log holds before writers wait for the slowest replica
+#define RADIX_LOG_BATCH 64  // Most log entries a replica applies before swapping its copies
+#define RADIX_MAX_REPLICAS 64  // Most NUMA nodes given a replica
+#define RADIX_CHANGES_MAGIC "RDXC"  // First bytes of an exported change batch
+#define RADIX_CHANGES_HEADER 28  // Bytes before the first change of a batch
 
 typedef struct RadixNode {
     char *key;                           // Compressed key segment
+    int key_len;                         // Length of the key segment
+    char *full_key;                      // Whole key of a terminal node, only kept in lazy_verify trees
     void *value;                         // Value stored at this node (NULL if not a terminal)
+    uint32_t value_id;                   // ID of the value in an interned tree, RADIX_NO_VALUE_ID otherwise
     struct RadixNode *children[MAX_CHILDREN];  // Children array
     int num_children;                    // Number of active children
     bool is_terminal;                    // True if this node represents end of a key
+    bool in_block;                       // Node lives in a compacted block, not in its own allocation
+    bool key_in_block;                   // Same for the key segment
+    bool full_key_in_block;              // Same for the full key
+    bool referenced;                     // Key used since the clock hand last passed (only kept when the tree has a budget)
+    double max_score;                    // Best score in this subtree (only kept when the tree has a score_fn)
+    int key_count;                       // Keys in this subtree (only kept when the tree has track_counts)
+    size_t bytes;                        // Node and key bytes in this subtree (only kept when the tree has a budget)
 } RadixNode;
 
+// How keys are laid out in the tree. Every key argument is converted to
+// the stored form and every reported key back to the caller's form, so the
+// reversed modes turn suffix queries into prefix walks. Prefix arguments
+// (radix_count_prefix, radix_topk) then select keys by their ending, and
+// traversal, rank and select follow the order of the stored forms.
+typedef enum {
+    RADIX_KEYS_FORWARD,                  // Keys stored as given
+    RADIX_KEYS_REVERSED,                 // Keys stored back to front
+    RADIX_KEYS_LABELS                    // Dot-separated labels stored last to first, "a.example.com" as "com.example.a"
+} RadixKeyMode;
+
+// Contiguous storage made by radix_compact, nodes and keys follow the header
+typedef struct RadixBlock {
+    struct RadixBlock *next;
+    size_t size;                         // Bytes including this header
+} RadixBlock;
+
+// Distinct values of an interned tree, each stored once under a 32-bit ID
+typedef struct {
+    size_t value_size;                   // Bytes per value
+    char **chunks;                       // RADIX_VALUE_CHUNK values each, never moved once allocated
+    int num_chunks;
+    uint32_t count;                      // Values stored, IDs run from 0 to count - 1
+    uint32_t *slots;                     // Hash table of ID + 1, 0 for an empty slot
+    uint32_t num_slots;                  // Power of two
+} RadixValueTable;
+
+// One logged update, in a replicated tree's log or a tree's change feed
+typedef struct {
+    char *key;
+    void *value;
+    bool is_delete;
+} RadixLogEntry;
+
 typedef struct {
     RadixNode *root;
     int size;
+    double (*score_fn)(void *value);     // Optional scoring of values, enables radix_topk
+    RadixBlock *blocks;                  // Blocks holding compacted nodes, freed with the tree
+    bool lazy_verify;                    // Terminals keep their full key, searches compare it once at the end
+    bool track_counts;                   // Nodes keep key_count, for counting, rank and select by descent
+    RadixValueTable *values;             // Interned values, NULL unless made by radix_create_interned
+    RadixNode **frozen_nodes;            // Distinct nodes of a frozen tree, which may be shared
+    int num_frozen_nodes;
+    bool frozen;                         // Set by radix_freeze, the tree can no longer change
+    RadixKeyMode key_mode;               // Set by radix_set_key_mode while the tree is empty
+    size_t budget;                       // Most node and key bytes kept before evicting keys, 0 for no limit
+    void (*on_evict)(const char *key, void *value);  // Told about each evicted key, may be NULL
+    char *clock_hand;                    // Stored form of the last key the clock hand visited, NULL before the first
+    RadixLogEntry *changes;              // Change feed ring, change s at s % change_capacity, NULL when off
+    int change_capacity;
+    uint64_t change_seq;                 // Sequence number the next change gets
+    uint64_t change_oldest;              // Oldest change still in the ring
 } RadixTree;
 
+// Memory used by a tree, as reported by radix_memory_usage
+typedef struct {
+    int nodes;                           // Live nodes
+    size_t node_bytes;                   // Live node structs
+    size_t key_bytes;                    // Live key segments and full keys, including terminators
+    size_t block_bytes;                  // Compacted blocks, including the space of nodes freed since
+    size_t total_bytes;                  // Heap taken by separately allocated nodes and keys plus the blocks, with malloc's overhead
+    size_t value_bytes;                  // Interned value storage and its hash table
+    int allocations;                     // Heap allocations behind total_bytes
+} RadixMemoryStats;
+
+// One key of a batched update, index keeps the caller's order for duplicate keys
+typedef struct {
+    const char *key;
+    void *value;
+    int index;
+} RadixBatchItem;
+
+// One position of a compiled glob pattern
+typedef struct {
+    bool star;                           // Matches any run of characters
+    uint64_t bytes[4];                   // Otherwise the characters it matches, one bit each
+} RadixGlobToken;
+
+// When writes to a replicated tree return
+typedef enum {
+    RADIX_REPLICA_SYNC,                  // Once every replica has applied them
+    RADIX_REPLICA_BOUNDED                // Once no replica is more than max_lag writes behind
+} RadixReplicaPolicy;
+
+struct RadixReplicated;
+
+// Searches in progress from one CPU, per version, alone on a cache line
+typedef struct {
+    uint64_t count[2];
+    char pad[64 - 2 * sizeof(uint64_t)];
+} RadixReaderSlot;
+
+// Copy of a replicated tree serving the CPUs of one NUMA node. It holds the
+// tree twice: searches read trees[active] while the applier updates the
+// other one, then the two are swapped and the applier catches up the old
+// copy once the searches still in it have left.
+typedef struct {
+    RadixTree *trees[2];
+    int active;                          // Copy new searches read
+    int version;                         // Counter new searches announce themselves in
+    RadixReaderSlot *readers;            // One slot per CPU of the node
+    cpu_set_t cpus;                      // CPUs of the node, where the applier thread runs
+    uint64_t applied;                    // Log entries applied so far
+    bool started;                        // The applier has created the trees (or failed to)
+    pthread_t applier;
+    struct RadixReplicated *set;
+} RadixReplica;
+
+// A tree kept once per NUMA node. Writes go to a log that each replica's
+// applier thread replays; searches read the replica of the calling CPU.
+typedef struct RadixReplicated {
+    RadixReplica *replicas;
+    int num_replicas;
+    int cpu_replica[CPU_SETSIZE];        // Replica serving each CPU
+    int cpu_slot[CPU_SETSIZE];           // Reader slot of each CPU in its replica
+    RadixLogEntry log[RADIX_LOG_CAPACITY];  // Ring of updates, entry i at i % RADIX_LOG_CAPACITY
+    uint64_t tail;                       // Entries appended so far
+    RadixReplicaPolicy policy;
+    uint64_t max_lag;                    // Entries a replica may trail by under RADIX_REPLICA_BOUNDED
+    bool stopping;
+    pthread_mutex_t lock;                // Guards the log, tail, applied counts and stopping
+    pthread_cond_t appended;             // Appliers wait here for entries
+    pthread_cond_t progress;             // Writers wait here for appliers
+} RadixReplicated;
+
+// Set operations combining two trees
+typedef enum {
+    RADIX_SET_UNION,
+    RADIX_SET_INTERSECT,
+    RADIX_SET_DIFFERENCE
+} RadixSetOp;
+
 // Function declarations
 RadixTree* radix_create();
+RadixTree* radix_create_scored(double (*score_fn)(void *value));
+RadixTree* radix_create_interned(size_t value_size);
 RadixNode* radix_node_create(const char *key);
 void radix_node_free(RadixNode *node);
 void radix_free(RadixTree *tree);
 int radix_insert(RadixTree *tree, const char *key, void *value);
 void* radix_search(RadixTree *tree, const char *key);
+void radix_set_lazy_verify(RadixTree *tree, bool enabled);
+uint32_t radix_intern_value(RadixTree *tree, const void *value);
+const void* radix_value_by_id(RadixTree *tree, uint32_t id);
+uint32_t radix_search_id(RadixTree *tree, const char *key);
+int radix_freeze(RadixTree *tree);
+void radix_set_track_counts(RadixTree *tree, bool enabled);
+int radix_count_prefix(RadixTree *tree, const char *prefix);
+int radix_rank(RadixTree *tree, const char *key);
+int radix_select(RadixTree *tree, int index, char *key, void **value);
 int radix_delete(RadixTree *tree, const char *key);
+int radix_insert_batch(RadixTree *tree, const char **keys, void **values, int count, bool presorted);
+int radix_delete_batch(RadixTree *tree, const char **keys, int count, bool presorted);
+int radix_union(RadixTree *dst, RadixTree *src, int num_threads);
+int radix_intersect(RadixTree *dst, RadixTree *other, int num_threads);
+int radix_difference(RadixTree *dst, RadixTree *other, int num_threads);
 void radix_traverse(RadixTree *tree, void (*callback)(const char*, void*));
 void radix_print(RadixTree *tree);
+void radix_traverse_parallel(RadixTree *tree, int num_threads, void (*callback)(const char*, void*, void*),
+                             void **accumulators, void (*reduce)(void*, void*));
+void radix_traverse_parallel_ordered(RadixTree *tree, int num_threads, void (*callback)(const char*, void*));
+void radix_memory_usage(RadixTree *tree, RadixMemoryStats *stats);
+int radix_compact(RadixTree *tree, RadixMemoryStats *before, RadixMemoryStats *after);
+int radix_rescore(RadixTree *tree, const char *key);
+int radix_topk(RadixTree *tree, const char *prefix, int k, void (*callback)(const char*, void*));
+int radix_fuzzy_search(RadixTree *tree, const char *query, int max_dist, void (*callback)(const char*, void*, int));
+int radix_match_pattern(RadixTree *tree, const char *pattern, void (*callback)(const char*, void*));
+int radix_set_key_mode(RadixTree *tree, RadixKeyMode mode);
+int radix_scan_suffix(RadixTree *tree, const char *suffix, void (*callback)(const char*, void*));
+int radix_match_suffixes(RadixTree *tree, const char *key, void (*callback)(const char*, void*));
+int radix_longest_suffix(RadixTree *tree, const char *key, void **value);
+int radix_set_budget(RadixTree *tree, size_t budget, void (*on_evict)(const char*, void*));
+size_t radix_used_bytes(RadixTree *tree);
+int radix_evict(RadixTree *tree, int max_steps);
+int radix_set_change_feed(RadixTree *tree, int capacity);
+uint64_t radix_change_seq(RadixTree *tree);
+int radix_export_changes(RadixTree *tree, uint64_t since, int max_changes, char **data, size_t *size);
+int radix_apply_changes(RadixTree *tree, const char *data, size_t size, uint64_t *seq);
+RadixReplicated* radix_replicated_create(RadixReplicaPolicy policy, int max_lag);
+void radix_replicated_free(RadixReplicated *set);
+int radix_replicated_insert(RadixReplicated *set, const char *key, void *value);
+int radix_replicated_delete(RadixReplicated *set, const char *key);
+void* radix_replicated_search(RadixReplicated *set, const char *key);
+void radix_replicated_sync(RadixReplicated *set);
+#if __cplusplus >= 202002L
+struct RadixSearchTask;
+RadixSearchTask async_search(RadixTree *tree, const char *key);
+int radix_search_interleaved(RadixTree *tree, const char **keys, int count, void **results, int width);
+#endif
 
 // Helper functions
 static int find_common_prefix_length(const char *str1, const char *str2);
-static RadixNode* radix_insert_recursive(RadixNode *node, const char *key, void *value, int *inserted);
-static void* radix_search_recursive(RadixNode *node, const char *key);
-static RadixNode* radix_delete_recursive(RadixNode *node, const char *key, int *deleted);
-static void radix_traverse_recursive(RadixNode *node, char *prefix, int prefix_len, void (*callback)(const char*, void*));
-static void radix_print_recursive(RadixNode *node, char *prefix, int prefix_len, int depth);
+static void radix_node_update_aggregates(RadixTree *tree, RadixNode *node);
+static void radix_node_replace_key(RadixNode *node, char *new_key);
+static void radix_node_release(RadixNode *node);
+static void radix_node_set_terminal(RadixTree *tree, RadixNode *node, const char *full_key, void *value);
+static void radix_node_clear_terminal(RadixNode *node);
+static void radix_key_flip(RadixKeyMode mode, char *key, int len);
+static const char* radix_key_encode(RadixTree *tree, const char *key, char *buf);
+static void radix_value_table_free(RadixValueTable *table);
+static void radix_intern_recursive(RadixTree *tree, RadixNode *node);
+static void radix_node_split(RadixNode *node, int common_len);
+static void radix_node_merge_child(RadixNode *node);
+static void radix_update_aggregates_recursive(RadixTree *tree, RadixNode *node);
+static int radix_evict_steps(RadixTree *tree, int max_steps, const char *keep);
+static void radix_change_record(RadixTree *tree, const char *key, void *value, bool is_delete);
+static void radix_change_reset(RadixTree *tree);
+static RadixNode* radix_insert_recursive(RadixTree *tree, RadixNode *node, const char *key, const char *full_key, void *value, int *inserted);
+static void* radix_search_converted(RadixTree *tree, const char *key);
+static RadixNode* radix_search_step(RadixTree *tree, RadixNode *node, const char *key, int key_len, int *depth, void **value);
+static RadixNode* radix_delete_recursive(RadixTree *tree, RadixNode *node, const char *key, int *deleted);
+static RadixNode* radix_find_prefix_node(RadixNode *node, const char *prefix, char *path, int *path_len);
+static int radix_fuzzy_recursive(RadixNode *node, const char *query, int query_len, int max_dist, const int *prev_row,
+                                 char *prefix, int prefix_len, RadixKeyMode mode, void (*callback)(const char*, void*, int));
+static RadixNode* radix_insert_batch_recursive(RadixTree *tree, RadixNode *node, RadixBatchItem *items, int count, int offset, int *inserted);
+static RadixNode* radix_delete_batch_recursive(RadixTree *tree, RadixNode *node, RadixBatchItem *items, int count, int offset, int *deleted);
+static RadixNode* radix_set_recursive(RadixSetOp op, RadixTree *tree, RadixNode *a, RadixNode *b, int b_offset, int *both);
+static void radix_set_children(RadixSetOp op, RadixTree *tree, RadixNode *a, RadixNode *b, int first, int stride, int *both);
+static int radix_match_recursive(RadixNode *node, const RadixGlobToken *tokens, int num_tokens, const uint64_t *states,
+                                 char *prefix, int prefix_len, RadixKeyMode mode, void (*callback)(const char*, void*));
+static int radix_traverse_recursive(RadixNode *node, char *prefix, int prefix_len, RadixKeyMode mode, void (*callback)(const char*, void*));
+static void radix_print_recursive(RadixNode *node, char *prefix, int prefix_len, int depth, RadixKeyMode mode);
 
 // Create a new radix tree
 RadixTree* radix_create() {
@@ -44,18 +272,120 @@ RadixTree* radix_create() {
     
     tree->root = radix_node_create("");
     tree->size = 0;
+    tree->score_fn = NULL;
+    tree->blocks = NULL;
+    tree->lazy_verify = false;
+    tree->track_counts = false;
+    tree->values = NULL;
+    tree->frozen_nodes = NULL;
+    tree->num_frozen_nodes = 0;
+    tree->frozen = false;
+    tree->key_mode = RADIX_KEYS_FORWARD;
+    tree->budget = 0;
+    tree->on_evict = NULL;
+    tree->clock_hand = NULL;
+    tree->changes = NULL;
+    tree->change_capacity = 0;
+    tree->change_seq = 0;
+    tree->change_oldest = 0;
+    return tree;
+}
+
+// Create a radix tree whose nodes track the best value score of their subtree
+RadixTree* radix_create_scored(double (*score_fn)(void *value)) {
+    RadixTree *tree = radix_create();
+    if (!tree) return NULL;
+    
+    tree->score_fn = score_fn;
+    tree->root->max_score = -INFINITY;
+    return tree;
+}
+
+// Create a radix tree that keeps one copy of each distinct value. Inserted
+// values point to value_size bytes, which are copied into the tree's value
+// table the first time they are seen. Searches return the shared copy, so
+// equal values compare equal as pointers. Values are only dropped with the
+// tree and must not be modified in place.
+RadixTree* radix_create_interned(size_t value_size) {
+    RadixTree *tree = radix_create();
+    if (!tree) return NULL;
+    
+    tree->values = (RadixValueTable*)calloc(1, sizeof(RadixValueTable));
+    if (!tree->values) {
+        radix_free(tree);
+        return NULL;
+    }
+    tree->values->value_size = value_size;
     return tree;
 }
 
+// Choose how keys are stored (see RadixKeyMode). Only an empty tree can
+// change mode. Returns 1 on success.
+int radix_set_key_mode(RadixTree *tree, RadixKeyMode mode) {
+    if (!tree || tree->frozen || tree->size > 0) return 0;
+    
+    tree->key_mode = mode;
+    return 1;
+}
+
+// Convert len characters of a key in place between the caller's form and
+// the stored form. Both conversions are their own inverse, so the same
+// call encodes a query and decodes a stored key.
+static void radix_key_flip(RadixKeyMode mode, char *key, int len) {
+    if (mode == RADIX_KEYS_FORWARD) return;
+    
+    for (int i = 0, j = len - 1; i < j; i++, j--) {
+        char c = key[i];
+        key[i] = key[j];
+        key[j] = c;
+    }
+    if (mode != RADIX_KEYS_LABELS) return;
+    
+    // Reversing the whole key reversed every label too, so turn each one back
+    int start = 0;
+    for (int end = 0; end <= len; end++) {
+        if (end < len && key[end] != '.') continue;
+        for (int i = start, j = end - 1; i < j; i++, j--) {
+            char c = key[i];
+            key[i] = key[j];
+            key[j] = c;
+        }
+        start = end + 1;
+    }
+}
+
+// Get a caller's key in the form the tree stores. Returns key itself when
+// keys are stored as given, otherwise buf (MAX_KEY_LENGTH characters)
+// holding the converted key, or NULL if the key does not fit.
+static const char* radix_key_encode(RadixTree *tree, const char *key, char *buf) {
+    if (tree->key_mode == RADIX_KEYS_FORWARD) return key;
+    
+    int len = strlen(key);
+    if (len >= MAX_KEY_LENGTH) return NULL;
+    memcpy(buf, key, len + 1);
+    radix_key_flip(tree->key_mode, buf, len);
+    return buf;
+}
+
 // Create a new radix tree node
 RadixNode* radix_node_create(const char *key) {
     RadixNode *node = (RadixNode*)malloc(sizeof(RadixNode));
     if (!node) return NULL;
     
     node->key = strdup(key);
+    node->key_len = strlen(key);
+    node->full_key = NULL;
     node->value = NULL;
+    node->value_id = RADIX_NO_VALUE_ID;
     node->num_children = 0;
     node->is_terminal = false;
+    node->in_block = false;
+    node->key_in_block = false;
+    node->full_key_in_block = false;
+    node->referenced = false;
+    node->max_score = -INFINITY;
+    node->key_count = 0;
+    node->bytes = 0;
     
     for (int i = 0; i < MAX_CHILDREN; i++) {
         node->children[i] = NULL;
@@ -74,18 +404,86 @@ void radix_node_free(RadixNode *node) {
         }
     }
     
-    free(node->key);
-    free(node);
+    radix_node_release(node);
 }
 
 // Free the entire radix tree
 void radix_free(RadixTree *tree) {
     if (!tree) return;
     
-    radix_node_free(tree->root);
+    if (tree->frozen) {
+        // Shared nodes are listed once, so free the list rather than walking
+        for (int i = 0; i < tree->num_frozen_nodes; i++) {
+            radix_node_release(tree->frozen_nodes[i]);
+        }
+        free(tree->frozen_nodes);
+    } else {
+        radix_node_free(tree->root);
+    }
+    radix_value_table_free(tree->values);
+    free(tree->clock_hand);
+    radix_set_change_feed(tree, 0);
+    while (tree->blocks) {
+        RadixBlock *next = tree->blocks->next;
+        free(tree->blocks);
+        tree->blocks = next;
+    }
     free(tree);
 }
 
+// Give a node a new, separately allocated key segment
+static void radix_node_replace_key(RadixNode *node, char *new_key) {
+    if (!node->key_in_block) {
+        free(node->key);
+    }
+    node->key = new_key;
+    node->key_len = strlen(new_key);
+    node->key_in_block = false;
+}
+
+// Free a single node, leaving its children alone. Nodes and keys inside a
+// compacted block are only given back when the block is.
+static void radix_node_release(RadixNode *node) {
+    if (!node->key_in_block) {
+        free(node->key);
+    }
+    if (!node->full_key_in_block) {
+        free(node->full_key);
+    }
+    if (!node->in_block) {
+        free(node);
+    }
+}
+
+// Make a node hold a key. full_key is the whole key, which lazy_verify
+// trees keep on the node the first time it becomes terminal.
+static void radix_node_set_terminal(RadixTree *tree, RadixNode *node, const char *full_key, void *value) {
+    node->is_terminal = true;
+    node->value = value;
+    node->value_id = RADIX_NO_VALUE_ID;
+    if (tree->values && value) {
+        node->value_id = radix_intern_value(tree, value);
+        node->value = (void*)radix_value_by_id(tree, node->value_id);
+    }
+    if (tree->lazy_verify && !node->full_key) {
+        node->full_key = strdup(full_key);
+        node->full_key_in_block = false;
+    }
+}
+
+// Make a node stop holding a key
+static void radix_node_clear_terminal(RadixNode *node) {
+    node->is_terminal = false;
+    node->referenced = false;
+    node->value = NULL;
+    node->value_id = RADIX_NO_VALUE_ID;
+    if (!node->full_key_in_block) {
+        free(node->full_key);
+    }
+    node->full_key = NULL;
+    node->full_key_in_block = false;
+}
+
 // Find the length of common prefix between two strings
 static int find_common_prefix_length(const char *str1, const char *str2) {
     int i = 0;
@@ -95,32 +493,144 @@ static int find_common_prefix_length(const char *str1, const char *str2) {
     return i;
 }
 
+// Recompute the cached subtree data of a node from its own value and its children
+static void radix_node_update_aggregates(RadixTree *tree, RadixNode *node) {
+    if (!node || (!tree->score_fn && !tree->track_counts && !tree->budget)) return;
+    
+    double best = node->is_terminal && tree->score_fn ? tree->score_fn(node->value) : -INFINITY;
+    int count = node->is_terminal ? 1 : 0;
+    size_t bytes = sizeof(RadixNode) + node->key_len + 1;
+    if (tree->budget && node->full_key) {
+        bytes += strlen(node->full_key) + 1;
+    }
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        RadixNode *child = node->children[i];
+        if (child) {
+            if (child->max_score > best) {
+                best = child->max_score;
+            }
+            count += child->key_count;
+            bytes += child->bytes;
+        }
+    }
+    node->max_score = best;
+    node->key_count = count;
+    node->bytes = bytes;
+}
+
+// Split a node after its first common_len key characters. The node keeps
+// the shared part and becomes non-terminal, while the rest of the key, the
+// value and the children move to a new single child.
+static void radix_node_split(RadixNode *node, int common_len) {
+    RadixNode *new_node = radix_node_create(node->key + common_len);
+    new_node->value = node->value;
+    new_node->value_id = node->value_id;
+    new_node->is_terminal = node->is_terminal;
+    new_node->full_key = node->full_key;
+    new_node->full_key_in_block = node->full_key_in_block;
+    new_node->referenced = node->referenced;
+    new_node->num_children = node->num_children;
+    new_node->max_score = node->max_score;
+    new_node->key_count = node->key_count;
+    new_node->bytes = node->bytes - common_len;
+    
+    // Move children to new node
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        new_node->children[i] = node->children[i];
+        node->children[i] = NULL;
+    }
+    
+    // Update current node
+    radix_node_replace_key(node, strndup(node->key, common_len));
+    
+    node->value = NULL;
+    node->value_id = RADIX_NO_VALUE_ID;
+    node->is_terminal = false;
+    node->referenced = false;
+    node->full_key = NULL;
+    node->full_key_in_block = false;
+    node->num_children = 1;
+    
+    // Add the split-off part as a child
+    unsigned char first_char = (unsigned char)new_node->key[0];
+    node->children[first_char] = new_node;
+}
+
+// Merge a node that has exactly one child with that child
+static void radix_node_merge_child(RadixNode *node) {
+    RadixNode *child = NULL;
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            child = node->children[i];
+            break;
+        }
+    }
+    
+    char *new_key = (char*)malloc(node->key_len + child->key_len + 1);
+    strcpy(new_key, node->key);
+    strcat(new_key, child->key);
+    
+    // One node struct goes away and the segments join
+    node->bytes = child->bytes + node->key_len;
+    radix_node_replace_key(node, new_key);
+    node->value = child->value;
+    node->value_id = child->value_id;
+    node->is_terminal = child->is_terminal;
+    node->full_key = child->full_key;
+    node->full_key_in_block = child->full_key_in_block;
+    node->referenced = child->referenced;
+    node->num_children = child->num_children;
+    node->max_score = child->max_score;
+    node->key_count = child->key_count;
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        node->children[i] = child->children[i];
+    }
+    
+    // The node was not terminal, so the child's full key is the only one
+    child->full_key = NULL;
+    radix_node_release(child);
+}
+
 // Insert a key-value pair into the radix tree
 int radix_insert(RadixTree *tree, const char *key, void *value) {
-    if (!tree || !key) return 0;
+    if (!tree || !key || tree->frozen) return 0;
+    
+    char stored[MAX_KEY_LENGTH];
+    const char *given = key;
+    key = radix_key_encode(tree, key, stored);
+    if (!key) return 0;
     
     int inserted = 0;
-    tree->root = radix_insert_recursive(tree->root, key, value, &inserted);
+    tree->root = radix_insert_recursive(tree, tree->root, key, key, value, &inserted);
     
     if (inserted) {
         tree->size++;
     }
+    if (tree->changes) {
+        radix_change_record(tree, given, value, false);
+    }
+    
+    // Make room by evicting other keys
+    if (tree->budget) {
+        radix_evict_steps(tree, RADIX_CLOCK_STEPS, key);
+    }
     
     return inserted;
 }
 
 // Recursive helper for insertion
-static RadixNode* radix_insert_recursive(RadixNode *node, const char *key, void *value, int *inserted) {
+static RadixNode* radix_insert_recursive(RadixTree *tree, RadixNode *node, const char *key, const char *full_key, void *value, int *inserted) {
     if (!node) {
         node = radix_node_create(key);
-        node->value = value;
-        node->is_terminal = true;
+        radix_node_set_terminal(tree, node, full_key, value);
         *inserted = 1;
+        radix_node_update_aggregates(tree, node);
         return node;
     }
     
     int common_len = find_common_prefix_length(node->key, key);
-    int node_key_len = strlen(node->key);
+    int node_key_len = node->key_len;
     int key_len = strlen(key);
     
     if (common_len == node_key_len) {
@@ -128,69 +638,47 @@ static RadixNode* radix_insert_recursive(RadixNode *node, const char *key, void
         if (common_len == key_len) {
             // Exact match - update value
             if (!node->is_terminal) {
-                node->is_terminal = true;
                 *inserted = 1;
             }
-            node->value = value;
+            radix_node_set_terminal(tree, node, full_key, value);
+            radix_node_update_aggregates(tree, node);
             return node;
         } else {
             // Continue with the remaining key
             const char *remaining_key = key + common_len;
             unsigned char first_char = (unsigned char)remaining_key[0];
             
+            RadixNode *old_child = node->children[first_char];
             node->children[first_char] = radix_insert_recursive(
-                node->children[first_char], remaining_key, value, inserted
+                tree, node->children[first_char], remaining_key, full_key, value, inserted
             );
             
-            if (node->children[first_char] && !node->children[first_char]->children[first_char]) {
+            if (!old_child && node->children[first_char]) {
                 node->num_children++;
             }
             
+            radix_node_update_aggregates(tree, node);
             return node;
         }
     } else {
         // Need to split the node
-        RadixNode *new_node = radix_node_create(node->key + common_len);
-        new_node->value = node->value;
-        new_node->is_terminal = node->is_terminal;
-        new_node->num_children = node->num_children;
-        
-        // Move children to new node
-        for (int i = 0; i < MAX_CHILDREN; i++) {
-            new_node->children[i] = node->children[i];
-            node->children[i] = NULL;
-        }
-        
-        // Update current node
-        char *old_key = node->key;
-        node->key = (char*)malloc(common_len + 1);
-        strncpy(node->key, old_key, common_len);
-        node->key[common_len] = '\0';
-        free(old_key);
-        
-        node->value = NULL;
-        node->is_terminal = false;
-        node->num_children = 1;
-        
-        // Add the split-off part as a child
-        unsigned char first_char = (unsigned char)new_node->key[0];
-        node->children[first_char] = new_node;
+        radix_node_split(node, common_len);
         
         // Insert the new key
         if (common_len == key_len) {
-            node->value = value;
-            node->is_terminal = true;
+            radix_node_set_terminal(tree, node, full_key, value);
             *inserted = 1;
         } else {
             const char *remaining_key = key + common_len;
             unsigned char new_first_char = (unsigned char)remaining_key[0];
             
             node->children[new_first_char] = radix_insert_recursive(
-                NULL, remaining_key, value, inserted
+                tree, NULL, remaining_key, full_key, value, inserted
             );
             node->num_children++;
         }
         
+        radix_node_update_aggregates(tree, node);
         return node;
     }
 }
@@ -198,59 +686,371 @@ static RadixNode* radix_insert_recursive(RadixNode *node, const char *key, void
 // Search for a key in the radix tree
 void* radix_search(RadixTree *tree, const char *key) {
     if (!tree || !key) return NULL;
+    if (tree->key_mode != RADIX_KEYS_FORWARD) return radix_search_converted(tree, key);
     
-    return radix_search_recursive(tree->root, key);
+    int key_len = strlen(key);
+    int depth = 0;
+    void *value = NULL;
+    RadixNode *node = tree->root;
+    while (node) {
+        node = radix_search_step(tree, node, key, key_len, &depth, &value);
+    }
+    return value;
 }
 
-// Recursive helper for search
-static void* radix_search_recursive(RadixNode *node, const char *key) {
-    if (!node) return NULL;
+// Search in a tree storing converted keys, kept apart so the buffer stays
+// out of the plain search
+static void* radix_search_converted(RadixTree *tree, const char *key) {
+    char stored[MAX_KEY_LENGTH];
+    key = radix_key_encode(tree, key, stored);
+    if (!key) return NULL;
     
-    int common_len = find_common_prefix_length(node->key, key);
-    int node_key_len = strlen(node->key);
     int key_len = strlen(key);
+    int depth = 0;
+    void *value = NULL;
+    RadixNode *node = tree->root;
+    while (node) {
+        node = radix_search_step(tree, node, key, key_len, &depth, &value);
+    }
+    return value;
+}
+
+// One level of a search. depth counts the key characters matched above
+// node. Returns the child to visit next, or NULL once the search ends,
+// with the value found (if any) in *value.
+//
+// In lazy_verify trees the segments are not compared on the way down:
+// each node only skips its segment length, and the child is picked by the
+// next key byte. A wrong turn can only be taken for a key that is not in
+// the tree, and the single comparison against the terminal's full key at
+// the end catches it.
+//
+// Trees with a budget mark the key found as used for the clock. Searches
+// may run side by side, so the mark is an atomic store, skipped when it is
+// already set to keep hot keys' nodes from bouncing between caches.
+static RadixNode* radix_search_step(RadixTree *tree, RadixNode *node, const char *key, int key_len, int *depth, void **value) {
+    int node_key_len = node->key_len;
+    if (*depth + node_key_len > key_len) return NULL;
+    if (!tree->lazy_verify && memcmp(node->key, key + *depth, node_key_len) != 0) return NULL;
     
-    if (common_len == node_key_len) {
-        if (common_len == key_len) {
-            return node->is_terminal ? node->value : NULL;
-        } else {
-            const char *remaining_key = key + common_len;
-            unsigned char first_char = (unsigned char)remaining_key[0];
-            return radix_search_recursive(node->children[first_char], remaining_key);
+    *depth += node_key_len;
+    if (*depth == key_len) {
+        if (node->is_terminal && (!tree->lazy_verify || strcmp(node->full_key, key) == 0)) {
+            *value = node->value;
+            if (tree->budget && !__atomic_load_n(&node->referenced, __ATOMIC_RELAXED)) {
+                __atomic_store_n(&node->referenced, true, __ATOMIC_RELAXED);
+            }
         }
+        return NULL;
     }
+    return node->children[(unsigned char)key[*depth]];
+}
+
+// Give every terminal its full key, or take the full keys away. prefix
+// holds capacity bytes; keys that do not fit are spelled out in a larger
+// buffer, since lazy searches need the full key of every terminal.
+static void radix_set_full_keys_recursive(RadixNode *node, char *prefix, int prefix_len, int capacity, bool keep) {
+    if (!node) return;
     
-    return NULL;
+    if (prefix_len + node->key_len >= capacity) {
+        int larger = (prefix_len + node->key_len + 1) * 2;
+        char *grown = (char*)malloc(larger);
+        if (!grown) return;
+        memcpy(grown, prefix, prefix_len);
+        radix_set_full_keys_recursive(node, grown, prefix_len, larger, keep);
+        free(grown);
+        return;
+    }
+    
+    memcpy(prefix + prefix_len, node->key, node->key_len + 1);
+    prefix_len += node->key_len;
+    
+    if (keep && node->is_terminal && !node->full_key) {
+        node->full_key = strdup(prefix);
+        node->full_key_in_block = false;
+    } else if (!keep && node->full_key) {
+        if (!node->full_key_in_block) {
+            free(node->full_key);
+        }
+        node->full_key = NULL;
+        node->full_key_in_block = false;
+    }
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        radix_set_full_keys_recursive(node->children[i], prefix, prefix_len, capacity, keep);
+    }
+}
+
+// Switch lazy key verification on or off. When on, every terminal node also
+// keeps its whole key, and radix_search follows only segment lengths and
+// compares the key once, at the node it ends on. Inserts and deletes still
+// compare whole segments, so they split and merge exactly as before.
+void radix_set_lazy_verify(RadixTree *tree, bool enabled) {
+    if (!tree || tree->frozen || tree->lazy_verify == enabled) return;
+    
+    char prefix[MAX_KEY_LENGTH];
+    tree->lazy_verify = enabled;
+    radix_set_full_keys_recursive(tree->root, prefix, 0, MAX_KEY_LENGTH, enabled);
+    
+    // Full keys are charged to the budget
+    if (tree->budget) {
+        radix_update_aggregates_recursive(tree, tree->root);
+    }
+}
+
+// FNV-1a over a value's bytes
+static uint32_t radix_hash_bytes(const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char*)data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void radix_value_table_free(RadixValueTable *table) {
+    if (!table) return;
+    
+    for (int i = 0; i < table->num_chunks; i++) {
+        free(table->chunks[i]);
+    }
+    free(table->chunks);
+    free(table->slots);
+    free(table);
+}
+
+// Double the hash table, keeping it at most half full
+static bool radix_value_table_grow(RadixValueTable *table) {
+    uint32_t num_slots = table->num_slots ? table->num_slots * 2 : 64;
+    uint32_t *slots = (uint32_t*)calloc(num_slots, sizeof(uint32_t));
+    if (!slots) return false;
+    
+    for (uint32_t id = 0; id < table->count; id++) {
+        const char *value = table->chunks[id / RADIX_VALUE_CHUNK] + (size_t)(id % RADIX_VALUE_CHUNK) * table->value_size;
+        uint32_t slot = radix_hash_bytes(value, table->value_size) & (num_slots - 1);
+        while (slots[slot]) {
+            slot = (slot + 1) & (num_slots - 1);
+        }
+        slots[slot] = id + 1;
+    }
+    
+    free(table->slots);
+    table->slots = slots;
+    table->num_slots = num_slots;
+    return true;
+}
+
+// Get the ID of a value in an interned tree, storing the value if it is new.
+// Returns RADIX_NO_VALUE_ID if the tree does not intern values or is out of memory.
+uint32_t radix_intern_value(RadixTree *tree, const void *value) {
+    if (!tree || !tree->values || !value) return RADIX_NO_VALUE_ID;
+    
+    RadixValueTable *table = tree->values;
+    if ((table->count + 1) * 2 > table->num_slots && !radix_value_table_grow(table)) {
+        return RADIX_NO_VALUE_ID;
+    }
+    
+    uint32_t slot = radix_hash_bytes(value, table->value_size) & (table->num_slots - 1);
+    while (table->slots[slot]) {
+        uint32_t id = table->slots[slot] - 1;
+        if (memcmp(radix_value_by_id(tree, id), value, table->value_size) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & (table->num_slots - 1);
+    }
+    if (table->count == RADIX_NO_VALUE_ID) return RADIX_NO_VALUE_ID;
+    
+    // Values are appended to fixed-size chunks, so stored values never move
+    uint32_t id = table->count;
+    if (id % RADIX_VALUE_CHUNK == 0) {
+        char **chunks = (char**)realloc(table->chunks, (table->num_chunks + 1) * sizeof(char*));
+        if (!chunks) return RADIX_NO_VALUE_ID;
+        table->chunks = chunks;
+        table->chunks[table->num_chunks] = (char*)malloc(RADIX_VALUE_CHUNK * table->value_size);
+        if (!table->chunks[table->num_chunks]) return RADIX_NO_VALUE_ID;
+        table->num_chunks++;
+    }
+    memcpy(table->chunks[id / RADIX_VALUE_CHUNK] + (size_t)(id % RADIX_VALUE_CHUNK) * table->value_size,
+           value, table->value_size);
+    table->slots[slot] = id + 1;
+    table->count++;
+    return id;
+}
+
+// Get the stored copy of an interned value
+const void* radix_value_by_id(RadixTree *tree, uint32_t id) {
+    if (!tree || !tree->values || id >= tree->values->count) return NULL;
+    
+    RadixValueTable *table = tree->values;
+    return table->chunks[id / RADIX_VALUE_CHUNK] + (size_t)(id % RADIX_VALUE_CHUNK) * table->value_size;
+}
+
+// Get the ID of the value stored under key, or RADIX_NO_VALUE_ID
+uint32_t radix_search_id(RadixTree *tree, const char *key) {
+    if (!tree || !key) return RADIX_NO_VALUE_ID;
+    
+    char stored[MAX_KEY_LENGTH];
+    key = radix_key_encode(tree, key, stored);
+    if (!key) return RADIX_NO_VALUE_ID;
+    
+    char path[MAX_KEY_LENGTH];
+    int path_len = 0;
+    RadixNode *node = radix_find_prefix_node(tree->root, key, path, &path_len);
+    if (!node || !node->is_terminal || path_len != (int)strlen(key)) return RADIX_NO_VALUE_ID;
+    
+    return node->value_id;
+}
+
+// Intern the values of a subtree coming from another tree
+static void radix_intern_recursive(RadixTree *tree, RadixNode *node) {
+    if (!node) return;
+    
+    if (node->is_terminal && node->value) {
+        node->value_id = radix_intern_value(tree, node->value);
+        node->value = (void*)radix_value_by_id(tree, node->value_id);
+    }
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        radix_intern_recursive(tree, node->children[i]);
+    }
+}
+
+// Identical subtrees found so far while freezing, by hash of their root
+typedef struct {
+    RadixNode **slots;
+    uint32_t num_slots;                  // Power of two
+    RadixNode **nodes;                   // Distinct nodes in the order they were kept
+    int count;
+} RadixFreezeState;
+
+static int radix_count_nodes(RadixNode *node) {
+    if (!node) return 0;
+    
+    int count = 1;
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        count += radix_count_nodes(node->children[i]);
+    }
+    return count;
+}
+
+// Hash a node by its contents. Its children are already shared, so equal
+// subtrees have equal child pointers.
+static uint32_t radix_node_hash(RadixNode *node) {
+    uint32_t hash = radix_hash_bytes(node->key, node->key_len);
+    hash = (hash ^ node->is_terminal) * 16777619u;
+    uintptr_t value = (uintptr_t)node->value;
+    hash = (hash ^ radix_hash_bytes(&value, sizeof(value))) * 16777619u;
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            uintptr_t child = (uintptr_t)node->children[i];
+            hash = (hash ^ radix_hash_bytes(&child, sizeof(child))) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static bool radix_node_equal(RadixNode *a, RadixNode *b) {
+    return a->key_len == b->key_len && a->is_terminal == b->is_terminal && a->value == b->value &&
+           a->num_children == b->num_children && strcmp(a->key, b->key) == 0 &&
+           memcmp(a->children, b->children, sizeof(a->children)) == 0;
+}
+
+// Share a subtree bottom-up, returning the node that now stands for it
+static RadixNode* radix_freeze_recursive(RadixNode *node, RadixFreezeState *state) {
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            node->children[i] = radix_freeze_recursive(node->children[i], state);
+        }
+    }
+    
+    uint32_t slot = radix_node_hash(node) & (state->num_slots - 1);
+    while (state->slots[slot]) {
+        if (radix_node_equal(state->slots[slot], node)) {
+            radix_node_release(node);
+            return state->slots[slot];
+        }
+        slot = (slot + 1) & (state->num_slots - 1);
+    }
+    
+    state->slots[slot] = node;
+    state->nodes[state->count++] = node;
+    return node;
+}
+
+// Make the tree read-only and store identical subtrees once, turning it
+// into a DAWG. Keys ending alike (".html", "/index") then share their
+// suffix nodes. Equal values only match as the same pointer, which an
+// interned tree guarantees. Lazy key verification is switched off, since
+// a shared node lies on many keys. Searches, traversals, top-k and fuzzy
+// search work as before. Every update is refused.
+// Returns the number of distinct nodes left, or -1 if out of memory.
+int radix_freeze(RadixTree *tree) {
+    if (!tree) return -1;
+    if (tree->frozen) return tree->num_frozen_nodes;
+    
+    int count = radix_count_nodes(tree->root);
+    RadixFreezeState state;
+    state.num_slots = 64;
+    while (state.num_slots < (uint32_t)count * 2) {
+        state.num_slots *= 2;
+    }
+    state.slots = (RadixNode**)calloc(state.num_slots, sizeof(RadixNode*));
+    state.nodes = (RadixNode**)malloc((count ? count : 1) * sizeof(RadixNode*));
+    state.count = 0;
+    if (!state.slots || !state.nodes) {
+        free(state.slots);
+        free(state.nodes);
+        return -1;
+    }
+    
+    // A frozen tree can no longer evict
+    tree->budget = 0;
+    radix_set_lazy_verify(tree, false);
+    if (tree->root) {
+        tree->root = radix_freeze_recursive(tree->root, &state);
+    }
+    free(state.slots);
+    
+    tree->frozen_nodes = state.nodes;
+    tree->num_frozen_nodes = state.count;
+    tree->frozen = true;
+    return state.count;
 }
 
 // Delete a key from the radix tree
 int radix_delete(RadixTree *tree, const char *key) {
-    if (!tree || !key) return 0;
+    if (!tree || !key || tree->frozen) return 0;
+    
+    char stored[MAX_KEY_LENGTH];
+    const char *given = key;
+    key = radix_key_encode(tree, key, stored);
+    if (!key) return 0;
     
     int deleted = 0;
-    tree->root = radix_delete_recursive(tree->root, key, &deleted);
+    tree->root = radix_delete_recursive(tree, tree->root, key, &deleted);
     
     if (deleted) {
         tree->size--;
+        if (tree->changes) {
+            radix_change_record(tree, given, NULL, true);
+        }
     }
     
     return deleted;
 }
 
 // Recursive helper for deletion
-static RadixNode* radix_delete_recursive(RadixNode *node, const char *key, int *deleted) {
+static RadixNode* radix_delete_recursive(RadixTree *tree, RadixNode *node, const char *key, int *deleted) {
     if (!node) return NULL;
     
     int common_len = find_common_prefix_length(node->key, key);
-    int node_key_len = strlen(node->key);
+    int node_key_len = node->key_len;
     int key_len = strlen(key);
     
     if (common_len == node_key_len) {
         if (common_len == key_len) {
             // Found the node to delete
             if (node->is_terminal) {
-                node->is_terminal = false;
-                node->value = NULL;
+                radix_node_clear_terminal(node);
                 *deleted = 1;
                 
                 // If node has no children, it can be removed
@@ -261,34 +1061,10 @@ static RadixNode* radix_delete_recursive(RadixNode *node, const char *key, int *
                 
                 // If node has only one child, merge with child
                 if (node->num_children == 1) {
-                    RadixNode *child = NULL;
-                    for (int i = 0; i < MAX_CHILDREN; i++) {
-                        if (node->children[i]) {
-                            child = node->children[i];
-                            break;
-                        }
-                    }
-                    
-                    // Merge node with its single child
-                    char *new_key = (char*)malloc(strlen(node->key) + strlen(child->key) + 1);
-                    strcpy(new_key, node->key);
-                    strcat(new_key, child->key);
-                    
-                    free(node->key);
-                    free(child->key);
-                    
-                    node->key = new_key;
-                    node->value = child->value;
-                    node->is_terminal = child->is_terminal;
-                    node->num_children = child->num_children;
-                    
-                    for (int i = 0; i < MAX_CHILDREN; i++) {
-                        node->children[i] = child->children[i];
-                    }
-                    
-                    free(child);
+                    radix_node_merge_child(node);
                 }
             }
+            radix_node_update_aggregates(tree, node);
             return node;
         } else {
             // Continue deletion in subtree
@@ -297,7 +1073,7 @@ static RadixNode* radix_delete_recursive(RadixNode *node, const char *key, int *
             
             RadixNode *old_child = node->children[first_char];
             node->children[first_char] = radix_delete_recursive(
-                node->children[first_char], remaining_key, deleted
+                tree, node->children[first_char], remaining_key, deleted
             );
             
             if (old_child && !node->children[first_char]) {
@@ -306,34 +1082,10 @@ static RadixNode* radix_delete_recursive(RadixNode *node, const char *key, int *
             
             // Check if current node can be merged or removed
             if (!node->is_terminal && node->num_children == 1) {
-                RadixNode *child = NULL;
-                for (int i = 0; i < MAX_CHILDREN; i++) {
-                    if (node->children[i]) {
-                        child = node->children[i];
-                        break;
-                    }
-                }
-                
-                // Merge node with its single child
-                char *new_key = (char*)malloc(strlen(node->key) + strlen(child->key) + 1);
-                strcpy(new_key, node->key);
-                strcat(new_key, child->key);
-                
-                free(node->key);
-                free(child->key);
-                
-                node->key = new_key;
-                node->value = child->value;
-                node->is_terminal = child->is_terminal;
-                node->num_children = child->num_children;
-                
-                for (int i = 0; i < MAX_CHILDREN; i++) {
-                    node->children[i] = child->children[i];
-                }
-                
-                free(child);
+                radix_node_merge_child(node);
             }
             
+            radix_node_update_aggregates(tree, node);
             return node;
         }
     }
@@ -341,74 +1093,2534 @@ static RadixNode* radix_delete_recursive(RadixNode *node, const char *key, int *
     return node;
 }
 
-// Traverse the radix tree and call callback for each key-value pair
-void radix_traverse(RadixTree *tree, void (*callback)(const char*, void*)) {
-    if (!tree || !callback) return;
+// Order batch items by key, and by position in the batch for equal keys
+static int radix_batch_item_compare(const void *a, const void *b) {
+    const RadixBatchItem *item_a = (const RadixBatchItem*)a;
+    const RadixBatchItem *item_b = (const RadixBatchItem*)b;
     
-    char prefix[1000];  // Assume keys won't exceed 1000 characters
-    radix_traverse_recursive(tree->root, prefix, 0, callback);
+    int cmp = strcmp(item_a->key, item_b->key);
+    if (cmp != 0) return cmp;
+    return item_a->index - item_b->index;
 }
 
-// Recursive helper for traversal
-static void radix_traverse_recursive(RadixNode *node, char *prefix, int prefix_len, void (*callback)(const char*, void*)) {
-    if (!node) return;
+// Copy a batch into sorted items. The keys are packed in sorted order right
+// after the items, in the same allocation, so the descent reads them
+// sequentially instead of chasing the caller's pointers. Keys the tree
+// stores converted are staged after that in batch order and always sorted,
+// as the caller's order says nothing about the order of the stored forms.
+static RadixBatchItem* radix_batch_prepare(RadixKeyMode mode, const char **keys, void **values, int count, bool presorted) {
+    size_t keys_size = 0;
+    for (int i = 0; i < count; i++) {
+        keys_size += strlen(keys[i]) + 1;
+    }
     
-    // Add current node's key to prefix
-    int key_len = strlen(node->key);
-    strcpy(prefix + prefix_len, node->key);
-    int new_prefix_len = prefix_len + key_len;
+    bool convert = mode != RADIX_KEYS_FORWARD;
+    RadixBatchItem *items = (RadixBatchItem*)malloc(count * sizeof(RadixBatchItem) + keys_size * (convert ? 2 : 1));
+    if (!items) return NULL;
     
-    // If this is a terminal node, call callback
-    if (node->is_terminal) {
-        prefix[new_prefix_len] = '\0';
-        callback(prefix, node->value);
+    char *staged = (char*)(items + count) + keys_size;
+    for (int i = 0; i < count; i++) {
+        items[i].key = keys[i];
+        items[i].value = values ? values[i] : NULL;
+        items[i].index = i;
+        if (convert) {
+            int len = strlen(keys[i]);
+            memcpy(staged, keys[i], len + 1);
+            radix_key_flip(mode, staged, len);
+            items[i].key = staged;
+            staged += len + 1;
+        }
     }
     
-    // Recurse on children
-    for (int i = 0; i < MAX_CHILDREN; i++) {
-        if (node->children[i]) {
-            radix_traverse_recursive(node->children[i], prefix, new_prefix_len, callback);
-        }
+    if (!presorted || convert) {
+        qsort(items, count, sizeof(RadixBatchItem), radix_batch_item_compare);
     }
-}
-
-// Print the radix tree structure
-void radix_print(RadixTree *tree) {
-    if (!tree) return;
     
-    printf("Radix Tree (size: %d):\n", tree->size);
-    char prefix[1000];
-    radix_print_recursive(tree->root, prefix, 0, 0);
+    char *packed = (char*)(items + count);
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(items[i].key) + 1;
+        memcpy(packed, items[i].key, len);
+        items[i].key = packed;
+        packed += len;
+    }
+    return items;
 }
 
-// Recursive helper for printing tree structure
-static void radix_print_recursive(RadixNode *node, char *prefix, int prefix_len, int depth) {
-    if (!node) return;
+// Insert many key-value pairs at once. The batch is sorted (unless the
+// caller says it already is), so every node is descended into once for all
+// the keys below it and is split at most once. When a key appears several
+// times the value that comes last in the batch wins, as with repeated
+// radix_insert calls. Returns the number of new keys.
+int radix_insert_batch(RadixTree *tree, const char **keys, void **values, int count, bool presorted) {
+    if (!tree || tree->frozen || !keys || count <= 0) return 0;
     
-    // Print indentation
-    for (int i = 0; i < depth; i++) {
-        printf("  ");
-    }
+    RadixBatchItem *items = radix_batch_prepare(tree->key_mode, keys, values, count, presorted);
+    if (!items) return 0;
     
-    // Add current node's key to prefix
-    int key_len = strlen(node->key);
-    strcpy(prefix + prefix_len, node->key);
-    int new_prefix_len = prefix_len + key_len;
-    prefix[new_prefix_len] = '\0';
+    int inserted = 0;
+    tree->root = radix_insert_batch_recursive(tree, tree->root, items, count, 0, &inserted);
+    tree->size += inserted;
+    
+    free(items);
+    if (tree->changes) {
+        for (int i = 0; i < count; i++) {
+            radix_change_record(tree, keys[i], values ? values[i] : NULL, false);
+        }
+    }
+    if (tree->budget) {
+        radix_evict_steps(tree, RADIX_CLOCK_STEPS * count, NULL);
+    }
+    return inserted;
+}
+
+// Recursive helper for batched insertion. All items share their first
+// offset characters, which are spelled by the path above node.
+static RadixNode* radix_insert_batch_recursive(RadixTree *tree, RadixNode *node, RadixBatchItem *items, int count, int offset, int *inserted) {
+    const char *first_key = items[0].key + offset;
+    const char *last_key = items[count - 1].key + offset;
+    int common_len = 0;
+    
+    // Sorted keys share exactly the prefix their first and last keys share
+    if (!node) {
+        common_len = find_common_prefix_length(first_key, last_key);
+        char *segment = strndup(first_key, common_len);
+        node = radix_node_create(segment);
+        free(segment);
+    } else {
+        while (node->key[common_len] && node->key[common_len] == first_key[common_len] &&
+               node->key[common_len] == last_key[common_len]) {
+            common_len++;
+        }
+        if (node->key[common_len]) {
+            radix_node_split(node, common_len);
+        }
+    }
+    
+    // Keys ending at this node sort first
+    int i = 0;
+    while (i < count && items[i].key[offset + common_len] == '\0') {
+        if (!node->is_terminal) {
+            (*inserted)++;
+        }
+        radix_node_set_terminal(tree, node, items[i].key, items[i].value);
+        i++;
+    }
+    
+    // The remaining keys are grouped by the character that selects their child
+    while (i < count) {
+        unsigned char first_char = (unsigned char)items[i].key[offset + common_len];
+        int j = i + 1;
+        while (j < count && (unsigned char)items[j].key[offset + common_len] == first_char) {
+            j++;
+        }
+        
+        RadixNode *old_child = node->children[first_char];
+        node->children[first_char] = radix_insert_batch_recursive(
+            tree, old_child, items + i, j - i, offset + common_len, inserted
+        );
+        if (!old_child) {
+            node->num_children++;
+        }
+        i = j;
+    }
+    
+    radix_node_update_aggregates(tree, node);
+    return node;
+}
+
+// Delete many keys at once, descending into each node once for all the
+// keys below it and merging or removing it at most once afterwards.
+// Returns the number of keys that were present.
+int radix_delete_batch(RadixTree *tree, const char **keys, int count, bool presorted) {
+    if (!tree || tree->frozen || !keys || count <= 0) return 0;
+    
+    RadixBatchItem *items = radix_batch_prepare(tree->key_mode, keys, NULL, count, presorted);
+    if (!items) return 0;
+    
+    int deleted = 0;
+    tree->root = radix_delete_batch_recursive(tree, tree->root, items, count, 0, &deleted);
+    tree->size -= deleted;
+    
+    // Which keys were present is not kept, so every key is logged; deleting an absent one changes nothing
+    free(items);
+    if (tree->changes && deleted) {
+        for (int i = 0; i < count; i++) {
+            radix_change_record(tree, keys[i], NULL, true);
+        }
+    }
+    return deleted;
+}
+
+// Recursive helper for batched deletion
+static RadixNode* radix_delete_batch_recursive(RadixTree *tree, RadixNode *node, RadixBatchItem *items, int count, int offset, int *deleted) {
+    if (!node) return NULL;
+    
+    int node_key_len = node->key_len;
+    int i = 0;
+    
+    while (i < count) {
+        const char *remaining_key = items[i].key + offset;
+        
+        // Keys that leave the tree inside this node's segment are not present
+        if (strncmp(remaining_key, node->key, node_key_len) != 0) {
+            i++;
+            continue;
+        }
+        
+        if (remaining_key[node_key_len] == '\0') {
+            if (node->is_terminal) {
+                radix_node_clear_terminal(node);
+                (*deleted)++;
+            }
+            i++;
+            continue;
+        }
+        
+        // Hand the whole run of keys below the same child to it at once
+        unsigned char first_char = (unsigned char)remaining_key[node_key_len];
+        int j = i + 1;
+        while (j < count && strncmp(items[j].key + offset, node->key, node_key_len) == 0 &&
+               (unsigned char)items[j].key[offset + node_key_len] == first_char) {
+            j++;
+        }
+        
+        RadixNode *old_child = node->children[first_char];
+        node->children[first_char] = radix_delete_batch_recursive(
+            tree, old_child, items + i, j - i, offset + node_key_len, deleted
+        );
+        if (old_child && !node->children[first_char]) {
+            node->num_children--;
+        }
+        i = j;
+    }
+    
+    if (!node->is_terminal) {
+        if (node->num_children == 0) {
+            radix_node_free(node);
+            return NULL;
+        }
+        if (node->num_children == 1) {
+            radix_node_merge_child(node);
+        }
+    }
+    
+    radix_node_update_aggregates(tree, node);
+    return node;
+}
+
+// Drop the first len characters of a node's key
+static void radix_node_strip_key(RadixNode *node, int len) {
+    if (len == 0) return;
+    
+    node->bytes -= len;
+    radix_node_replace_key(node, strdup(node->key + len));
+}
+
+// Recount a node's children after they were replaced, then remove it or
+// merge it with its only child when it no longer holds a key of its own
+static RadixNode* radix_node_normalize(RadixTree *tree, RadixNode *node) {
+    node->num_children = 0;
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            node->num_children++;
+        }
+    }
+    
+    if (!node->is_terminal) {
+        if (node->num_children == 0) {
+            radix_node_free(node);
+            return NULL;
+        }
+        if (node->num_children == 1) {
+            radix_node_merge_child(node);
+        }
+    }
+    
+    radix_node_update_aggregates(tree, node);
+    return node;
+}
+
+// Recompute the cached subtree data of a whole subtree
+static void radix_update_aggregates_recursive(RadixTree *tree, RadixNode *node) {
+    if (!node) return;
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        radix_update_aggregates_recursive(tree, node->children[i]);
+    }
+    radix_node_update_aggregates(tree, node);
+}
+
+// Combine the keys ending at a and b, two nodes spelling the same key
+static void radix_set_terminal(RadixSetOp op, RadixNode *a, RadixNode *b, int *both) {
+    if (a->is_terminal && b->is_terminal) {
+        (*both)++;
+    }
+    
+    if (op == RADIX_SET_UNION) {
+        if (b->is_terminal) {
+            a->value = b->value;
+            a->value_id = b->value_id;
+            a->is_terminal = true;
+            if (!a->full_key) {
+                // b is released after the merge, its full key moves to a
+                a->full_key = b->full_key;
+                a->full_key_in_block = b->full_key_in_block;
+                b->full_key = NULL;
+            }
+        }
+    } else if (op == RADIX_SET_INTERSECT ? !b->is_terminal : b->is_terminal) {
+        radix_node_clear_terminal(a);
+    }
+}
+
+// Combine the children of a and b, two nodes spelling the same key.
+// Only every stride-th child slot starting at first is handled, so the
+// slots can be shared out between threads.
+static void radix_set_children(RadixSetOp op, RadixTree *tree, RadixNode *a, RadixNode *b, int first, int stride, int *both) {
+    for (int i = first; i < MAX_CHILDREN; i += stride) {
+        if (a->children[i] || b->children[i]) {
+            a->children[i] = radix_set_recursive(op, tree, a->children[i], b->children[i], 0, both);
+        }
+    }
+}
+
+// Recursive helper for set operations. a belongs to the tree being
+// updated and b to the other tree, where the first b_offset characters of
+// b's key were already matched above. Subtrees found on one side only are
+// kept, dropped or (for a union) grafted whole, without visiting them.
+// both counts the keys present in both trees.
+static RadixNode* radix_set_recursive(RadixSetOp op, RadixTree *tree, RadixNode *a, RadixNode *b, int b_offset, int *both) {
+    if (!a || !b) {
+        if (op == RADIX_SET_INTERSECT) {
+            radix_node_free(a);
+            return NULL;
+        }
+        if (op == RADIX_SET_UNION && !a) {
+            radix_node_strip_key(b, b_offset);
+            return b;
+        }
+        return a;
+    }
+    
+    const char *b_key = b->key + b_offset;
+    int common_len = find_common_prefix_length(a->key, b_key);
+    int a_key_len = a->key_len;
+    int b_key_len = b->key_len - b_offset;
+    
+    if (common_len < a_key_len && common_len < b_key_len) {
+        // The keys diverge inside both segments, so no key is shared
+        if (op == RADIX_SET_INTERSECT) {
+            radix_node_free(a);
+            return NULL;
+        }
+        if (op == RADIX_SET_DIFFERENCE) {
+            return a;
+        }
+        
+        char *segment = strndup(a->key, common_len);
+        RadixNode *parent = radix_node_create(segment);
+        free(segment);
+        
+        radix_node_strip_key(a, common_len);
+        radix_node_strip_key(b, b_offset + common_len);
+        parent->children[(unsigned char)a->key[0]] = a;
+        parent->children[(unsigned char)b->key[0]] = b;
+        parent->num_children = 2;
+        radix_node_update_aggregates(tree, parent);
+        return parent;
+    }
+    
+    if (common_len < a_key_len) {
+        // b's segment ends inside a's segment
+        radix_node_split(a, common_len);
+    }
+    
+    if (common_len < b_key_len) {
+        // a's segment ends inside b's segment, only one child of a can meet b
+        unsigned char first_char = (unsigned char)b_key[common_len];
+        
+        if (op == RADIX_SET_INTERSECT) {
+            radix_node_clear_terminal(a);
+            for (int i = 0; i < MAX_CHILDREN; i++) {
+                if (i != first_char && a->children[i]) {
+                    radix_node_free(a->children[i]);
+                    a->children[i] = NULL;
+                }
+            }
+        }
+        
+        a->children[first_char] = radix_set_recursive(op, tree, a->children[first_char], b, b_offset + common_len, both);
+    } else {
+        radix_set_terminal(op, a, b, both);
+        radix_set_children(op, tree, a, b, 0, 1, both);
+        
+        if (op == RADIX_SET_UNION) {
+            // b's children now belong to a
+            radix_node_release(b);
+        }
+    }
+    
+    return radix_node_normalize(tree, a);
+}
+
+// Work of one thread in a parallel set operation
+typedef struct {
+    RadixSetOp op;
+    RadixTree *tree;
+    RadixNode *a;
+    RadixNode *b;
+    int first;
+    int stride;
+    int both;
+} RadixSetTask;
+
+static void* radix_set_thread(void *arg) {
+    RadixSetTask *task = (RadixSetTask*)arg;
+    radix_set_children(task->op, task->tree, task->a, task->b, task->first, task->stride, &task->both);
+    return NULL;
+}
+
+// Apply a set operation to dst. When both roots spell the same key (the
+// usual empty root) and num_threads > 1, the top-level children are split
+// between threads, since their subtrees never touch each other.
+static int radix_set_operation(RadixSetOp op, RadixTree *dst, RadixTree *other, int num_threads) {
+    RadixNode *a = dst->root;
+    RadixNode *b = other->root;
+    int both = 0;
+    
+    if (num_threads > 1 && a && b && strcmp(a->key, b->key) == 0) {
+        if (num_threads > MAX_CHILDREN) num_threads = MAX_CHILDREN;
+        
+        pthread_t threads[MAX_CHILDREN];
+        bool running[MAX_CHILDREN];
+        RadixSetTask *tasks = (RadixSetTask*)malloc(num_threads * sizeof(RadixSetTask));
+        if (!tasks) return radix_set_operation(op, dst, other, 1);
+        
+        radix_set_terminal(op, a, b, &both);
+        for (int t = 0; t < num_threads; t++) {
+            tasks[t].op = op;
+            tasks[t].tree = dst;
+            tasks[t].a = a;
+            tasks[t].b = b;
+            tasks[t].first = t;
+            tasks[t].stride = num_threads;
+            tasks[t].both = 0;
+            
+            // A task whose thread does not start runs here instead
+            running[t] = pthread_create(&threads[t], NULL, radix_set_thread, &tasks[t]) == 0;
+            if (!running[t]) {
+                radix_set_thread(&tasks[t]);
+            }
+        }
+        for (int t = 0; t < num_threads; t++) {
+            if (running[t]) {
+                pthread_join(threads[t], NULL);
+            }
+            both += tasks[t].both;
+        }
+        
+        free(tasks);
+        
+        if (op == RADIX_SET_UNION) {
+            radix_node_release(b);
+        }
+        dst->root = radix_node_normalize(dst, a);
+    } else {
+        dst->root = radix_set_recursive(op, dst, a, b, 0, &both);
+    }
+    
+    return both;
+}
+
+// Add every key of src to dst, src's value winning for keys in both.
+// src's nodes are moved into dst and src is freed. A src with interned
+// values can only be added to a tree interning values of the same size.
+// Both trees must store keys in the same mode.
+int radix_union(RadixTree *dst, RadixTree *src, int num_threads) {
+    if (!dst || !src || dst->frozen || src->frozen || dst->key_mode != src->key_mode) return 0;
+    if (src->values && (!dst->values || dst->values->value_size != src->values->value_size)) return 0;
+    
+    // src's value table goes away with src, so its values move to dst's
+    if (dst->values) {
+        radix_intern_recursive(dst, src->root);
+    }
+    
+    int both = radix_set_operation(RADIX_SET_UNION, dst, src, num_threads);
+    dst->size += src->size - both;
+    radix_change_reset(dst);
+    
+    // Grafted terminals carry full keys only if src verifies lazily too
+    if (dst->lazy_verify != src->lazy_verify) {
+        char prefix[MAX_KEY_LENGTH];
+        radix_set_full_keys_recursive(dst->root, prefix, 0, MAX_KEY_LENGTH, dst->lazy_verify);
+    }
+    
+    // Grafted subtrees carry src's scores, counts and sizes, which only fit if src keeps them alike
+    if ((dst->score_fn && dst->score_fn != src->score_fn) || (dst->track_counts && !src->track_counts) ||
+        (dst->budget && (!src->budget || dst->lazy_verify != src->lazy_verify))) {
+        radix_update_aggregates_recursive(dst, dst->root);
+    }
+    
+    // Grafted nodes may live in src's compacted blocks, which dst now owns
+    RadixBlock **last = &dst->blocks;
+    while (*last) {
+        last = &(*last)->next;
+    }
+    *last = src->blocks;
+    src->blocks = NULL;
+    
+    src->root = NULL;
+    radix_free(src);
+    return dst->size;
+}
+
+// Keep in dst only the keys that are also in other
+int radix_intersect(RadixTree *dst, RadixTree *other, int num_threads) {
+    if (!dst || !other || dst->frozen || dst->key_mode != other->key_mode) return 0;
+    
+    dst->size = radix_set_operation(RADIX_SET_INTERSECT, dst, other, num_threads);
+    radix_change_reset(dst);
+    return dst->size;
+}
+
+// Remove from dst every key that is in other
+int radix_difference(RadixTree *dst, RadixTree *other, int num_threads) {
+    if (!dst || !other || dst->frozen || dst->key_mode != other->key_mode) return 0;
+    
+    dst->size -= radix_set_operation(RADIX_SET_DIFFERENCE, dst, other, num_threads);
+    radix_change_reset(dst);
+    return dst->size;
+}
+
+// Traverse the radix tree and call callback for each key-value pair
+void radix_traverse(RadixTree *tree, void (*callback)(const char*, void*)) {
+    if (!tree || !callback) return;
+    
+    char prefix[MAX_KEY_LENGTH];
+    radix_traverse_recursive(tree->root, prefix, 0, tree->key_mode, callback);
+}
+
+// Recursive helper for traversal, returns the number of keys visited.
+// Keys are reported in the caller's form, converted in place in prefix.
+static int radix_traverse_recursive(RadixNode *node, char *prefix, int prefix_len, RadixKeyMode mode, void (*callback)(const char*, void*)) {
+    if (!node) return 0;
+    
+    // Add current node's key to prefix
+    int key_len = node->key_len;
+    strcpy(prefix + prefix_len, node->key);
+    int new_prefix_len = prefix_len + key_len;
+    
+    // If this is a terminal node, call callback
+    int visited = 0;
+    if (node->is_terminal) {
+        prefix[new_prefix_len] = '\0';
+        radix_key_flip(mode, prefix, new_prefix_len);
+        callback(prefix, node->value);
+        radix_key_flip(mode, prefix, new_prefix_len);
+        visited++;
+    }
+    
+    // Recurse on children
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            visited += radix_traverse_recursive(node->children[i], prefix, new_prefix_len, mode, callback);
+        }
+    }
+    return visited;
+}
+
+// Unit of work of a parallel traversal: either the whole subtree of node
+// or, for the nodes above the split level, only node's own key
+typedef struct {
+    RadixNode *node;
+    char *prefix;      // Key spelled above node
+    bool self_only;
+    
+    // Output kept for the ordered variant, flushed in task order
+    char *keys;        // Keys written back to back, NUL-terminated
+    size_t keys_len, keys_cap;
+    void **values;
+    int count, capacity;
+    bool done;
+} RadixTraverseTask;
+
+typedef struct {
+    RadixTraverseTask *tasks;
+    int num_tasks;
+    int next_task;     // Next task to hand out, taken with an atomic increment
+    void (*callback)(const char*, void*, void*);
+    bool ordered;
+    void (*ordered_callback)(const char*, void*);
+    RadixKeyMode key_mode;
+    pthread_mutex_t lock;
+    pthread_cond_t task_done;
+} RadixParallelTraversal;
+
+typedef struct {
+    RadixParallelTraversal *walk;
+    void *accumulator;
+} RadixTraverseWorker;
+
+static void radix_traverse_add_task(RadixParallelTraversal *walk, int *capacity, RadixNode *node,
+                                    const char *prefix, bool self_only) {
+    if (walk->num_tasks == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        walk->tasks = (RadixTraverseTask*)realloc(walk->tasks, *capacity * sizeof(RadixTraverseTask));
+    }
+    
+    RadixTraverseTask *task = &walk->tasks[walk->num_tasks++];
+    memset(task, 0, sizeof(RadixTraverseTask));
+    task->node = node;
+    task->prefix = strdup(prefix);
+    task->self_only = self_only;
+}
+
+// Cut the tree into tasks in key order: the keys of the root and of its
+// children are tasks of their own, and every grandchild subtree is a task
+static void radix_traverse_split(RadixTree *tree, RadixParallelTraversal *walk) {
+    int capacity = 0;
+    RadixNode *root = tree->root;
+    if (!root) return;
+    
+    if (root->is_terminal) {
+        radix_traverse_add_task(walk, &capacity, root, "", true);
+    }
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        RadixNode *child = root->children[i];
+        if (!child) continue;
+        
+        int prefix_len = root->key_len + child->key_len;
+        if (prefix_len >= MAX_KEY_LENGTH) continue;
+        
+        char prefix[MAX_KEY_LENGTH];
+        strcpy(prefix, root->key);
+        if (child->is_terminal) {
+            radix_traverse_add_task(walk, &capacity, child, prefix, true);
+        }
+        
+        strcat(prefix, child->key);
+        for (int j = 0; j < MAX_CHILDREN; j++) {
+            if (child->children[j]) {
+                radix_traverse_add_task(walk, &capacity, child->children[j], prefix, false);
+            }
+        }
+    }
+}
+
+// Hand a key found by a worker to the callback, or buffer it for the ordered variant
+static void radix_traverse_emit(RadixParallelTraversal *walk, RadixTraverseTask *task, const char *key,
+                                void *value, void *accumulator) {
+    if (!walk->ordered) {
+        walk->callback(key, value, accumulator);
+        return;
+    }
+    
+    size_t key_size = strlen(key) + 1;
+    if (task->keys_len + key_size > task->keys_cap) {
+        task->keys_cap = (task->keys_len + key_size) * 2;
+        task->keys = (char*)realloc(task->keys, task->keys_cap);
+    }
+    if (task->count == task->capacity) {
+        task->capacity = task->capacity ? task->capacity * 2 : 16;
+        task->values = (void**)realloc(task->values, task->capacity * sizeof(void*));
+    }
+    
+    memcpy(task->keys + task->keys_len, key, key_size);
+    task->keys_len += key_size;
+    task->values[task->count++] = value;
+}
+
+// Same walk as radix_traverse_recursive, reporting into a task
+static void radix_traverse_task_recursive(RadixParallelTraversal *walk, RadixTraverseTask *task, RadixNode *node,
+                                          char *prefix, int prefix_len, void *accumulator) {
+    int key_len = node->key_len;
+    if (prefix_len + key_len >= MAX_KEY_LENGTH) return;
+    
+    strcpy(prefix + prefix_len, node->key);
+    int new_prefix_len = prefix_len + key_len;
+    
+    if (node->is_terminal) {
+        radix_key_flip(walk->key_mode, prefix, new_prefix_len);
+        radix_traverse_emit(walk, task, prefix, node->value, accumulator);
+        radix_key_flip(walk->key_mode, prefix, new_prefix_len);
+    }
+    if (task->self_only) return;
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            radix_traverse_task_recursive(walk, task, node->children[i], prefix, new_prefix_len, accumulator);
+        }
+    }
+}
+
+// Workers keep taking the next unclaimed task, so threads that drew small
+// subtrees go on to take more work instead of waiting for the others
+static void* radix_traverse_worker(void *arg) {
+    RadixTraverseWorker *worker = (RadixTraverseWorker*)arg;
+    RadixParallelTraversal *walk = worker->walk;
+    char prefix[MAX_KEY_LENGTH];
+    
+    while (true) {
+        int t = __atomic_fetch_add(&walk->next_task, 1, __ATOMIC_RELAXED);
+        if (t >= walk->num_tasks) break;
+        
+        RadixTraverseTask *task = &walk->tasks[t];
+        int prefix_len = strlen(task->prefix);
+        strcpy(prefix, task->prefix);
+        radix_traverse_task_recursive(walk, task, task->node, prefix, prefix_len, worker->accumulator);
+        
+        if (walk->ordered) {
+            pthread_mutex_lock(&walk->lock);
+            task->done = true;
+            pthread_cond_broadcast(&walk->task_done);
+            pthread_mutex_unlock(&walk->lock);
+        }
+    }
+    return NULL;
+}
+
+static void radix_traverse_flush_ordered(RadixParallelTraversal *walk);
+
+// Split the tree into tasks and run them on num_threads workers
+static void radix_traverse_run(RadixTree *tree, int num_threads, RadixParallelTraversal *walk,
+                               void **accumulators) {
+    walk->tasks = NULL;
+    walk->num_tasks = 0;
+    walk->next_task = 0;
+    walk->key_mode = tree->key_mode;
+    pthread_mutex_init(&walk->lock, NULL);
+    pthread_cond_init(&walk->task_done, NULL);
+    radix_traverse_split(tree, walk);
+    
+    if (num_threads < 1) num_threads = 1;
+    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    RadixTraverseWorker *workers = (RadixTraverseWorker*)malloc(num_threads * sizeof(RadixTraverseWorker));
+    
+    // Workers take tasks until none are left, so those that started cover for any that did not
+    int started = 0;
+    if (threads && workers) {
+        for (int t = 0; t < num_threads; t++) {
+            workers[t].walk = walk;
+            workers[t].accumulator = accumulators ? accumulators[t] : NULL;
+            if (pthread_create(&threads[t], NULL, radix_traverse_worker, &workers[t]) != 0) break;
+            started++;
+        }
+    }
+    if (started == 0) {
+        RadixTraverseWorker self;
+        self.walk = walk;
+        self.accumulator = accumulators ? accumulators[0] : NULL;
+        radix_traverse_worker(&self);
+    }
+    
+    if (walk->ordered) {
+        radix_traverse_flush_ordered(walk);
+    }
+    
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    for (int t = 0; t < walk->num_tasks; t++) {
+        free(walk->tasks[t].prefix);
+        free(walk->tasks[t].keys);
+        free(walk->tasks[t].values);
+    }
+    free(walk->tasks);
+    free(threads);
+    free(workers);
+    pthread_mutex_destroy(&walk->lock);
+    pthread_cond_destroy(&walk->task_done);
+}
+
+// Visit every key on num_threads threads, in no particular order. Worker t
+// passes accumulators[t] to the callback, so it can aggregate without
+// locking. Afterwards reduce folds every accumulator into accumulators[0].
+// Work is handed out per subtree below the root's children.
+void radix_traverse_parallel(RadixTree *tree, int num_threads, void (*callback)(const char*, void*, void*),
+                             void **accumulators, void (*reduce)(void*, void*)) {
+    if (!tree || !callback) return;
+    if (num_threads < 1) num_threads = 1;
+    
+    RadixParallelTraversal walk;
+    walk.callback = callback;
+    walk.ordered = false;
+    walk.ordered_callback = NULL;
+    radix_traverse_run(tree, num_threads, &walk, accumulators);
+    
+    if (accumulators && reduce) {
+        for (int t = 1; t < num_threads; t++) {
+            reduce(accumulators[0], accumulators[t]);
+        }
+    }
+}
+
+// Report the buffered output of each task in key order, as soon as it is complete
+static void radix_traverse_flush_ordered(RadixParallelTraversal *walk) {
+    for (int t = 0; t < walk->num_tasks; t++) {
+        RadixTraverseTask *task = &walk->tasks[t];
+        
+        pthread_mutex_lock(&walk->lock);
+        while (!task->done) {
+            pthread_cond_wait(&walk->task_done, &walk->lock);
+        }
+        pthread_mutex_unlock(&walk->lock);
+        
+        const char *key = task->keys;
+        for (int i = 0; i < task->count; i++) {
+            walk->ordered_callback(key, task->values[i]);
+            key += strlen(key) + 1;
+        }
+        
+        free(task->keys);
+        free(task->values);
+        task->keys = NULL;
+        task->values = NULL;
+    }
+}
+
+// Visit every key in sorted order like radix_traverse, with the subtrees
+// walked on num_threads threads. Each task buffers its keys and the calling
+// thread reports them in order, so the callback never runs concurrently.
+void radix_traverse_parallel_ordered(RadixTree *tree, int num_threads, void (*callback)(const char*, void*)) {
+    if (!tree || !callback) return;
+    
+    RadixParallelTraversal walk;
+    walk.callback = NULL;
+    walk.ordered = true;
+    walk.ordered_callback = callback;
+    radix_traverse_run(tree, num_threads, &walk, NULL);
+}
+
+// Heap taken by one allocation of size bytes, as glibc's malloc hands it
+// out: an 8-byte header, rounded up to 16 bytes, 32 bytes at least. Short
+// keys cost several times their length this way, which is what packing
+// them into a block saves.
+static size_t radix_heap_size(size_t size) {
+    size_t chunk = (size + 8 + 15) & ~(size_t)15;
+    return chunk < 32 ? 32 : chunk;
+}
+
+static void radix_memory_usage_node(RadixNode *node, RadixMemoryStats *stats) {
+    size_t key_size = node->key_len + 1;
+    stats->nodes++;
+    stats->node_bytes += sizeof(RadixNode);
+    stats->key_bytes += key_size;
+    if (!node->in_block) {
+        stats->total_bytes += radix_heap_size(sizeof(RadixNode));
+        stats->allocations++;
+    }
+    if (!node->key_in_block) {
+        stats->total_bytes += radix_heap_size(key_size);
+        stats->allocations++;
+    }
+    if (node->full_key) {
+        size_t full_key_size = strlen(node->full_key) + 1;
+        stats->key_bytes += full_key_size;
+        if (!node->full_key_in_block) {
+            stats->total_bytes += radix_heap_size(full_key_size);
+            stats->allocations++;
+        }
+    }
+}
+
+static void radix_memory_usage_recursive(RadixNode *node, RadixMemoryStats *stats) {
+    if (!node) return;
+    
+    radix_memory_usage_node(node, stats);
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        radix_memory_usage_recursive(node->children[i], stats);
+    }
+}
+
+// Measure the memory held by the tree's nodes and keys
+void radix_memory_usage(RadixTree *tree, RadixMemoryStats *stats) {
+    memset(stats, 0, sizeof(RadixMemoryStats));
+    if (!tree) return;
+    
+    if (tree->frozen) {
+        // Shared nodes count once
+        for (int i = 0; i < tree->num_frozen_nodes; i++) {
+            radix_memory_usage_node(tree->frozen_nodes[i], stats);
+        }
+        stats->total_bytes += radix_heap_size(tree->num_frozen_nodes * sizeof(RadixNode*));
+        stats->allocations++;
+    } else {
+        radix_memory_usage_recursive(tree->root, stats);
+    }
+    if (tree->values) {
+        RadixValueTable *table = tree->values;
+        stats->value_bytes = (size_t)table->num_chunks * RADIX_VALUE_CHUNK * table->value_size +
+                             table->num_chunks * sizeof(char*) + table->num_slots * sizeof(uint32_t);
+        stats->total_bytes += table->num_chunks * radix_heap_size(RADIX_VALUE_CHUNK * table->value_size) +
+                              radix_heap_size(table->num_chunks * sizeof(char*)) +
+                              radix_heap_size(table->num_slots * sizeof(uint32_t)) +
+                              radix_heap_size(sizeof(RadixValueTable));
+        stats->allocations += table->num_chunks + 3;
+    }
+    for (RadixBlock *block = tree->blocks; block; block = block->next) {
+        stats->block_bytes += block->size;
+        stats->total_bytes += radix_heap_size(block->size);
+        stats->allocations++;
+    }
+}
+
+// Move a subtree into the block, parents before children, and free the old copies
+static RadixNode* radix_compact_recursive(RadixNode *node, RadixNode **next_node, char **next_key) {
+    RadixNode *copy = (*next_node)++;
+    *copy = *node;
+    
+    size_t key_size = node->key_len + 1;
+    memcpy(*next_key, node->key, key_size);
+    copy->key = *next_key;
+    *next_key += key_size;
+    copy->in_block = true;
+    copy->key_in_block = true;
+    
+    if (node->full_key) {
+        size_t full_key_size = strlen(node->full_key) + 1;
+        memcpy(*next_key, node->full_key, full_key_size);
+        copy->full_key = *next_key;
+        *next_key += full_key_size;
+        copy->full_key_in_block = true;
+    }
+    
+    radix_node_release(node);
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (copy->children[i]) {
+            copy->children[i] = radix_compact_recursive(copy->children[i], next_node, next_key);
+        }
+    }
+    return copy;
+}
+
+// Relocate every node into one fresh block in depth-first order, followed
+// by all key segments packed back to back, then free the old nodes, keys
+// and blocks. A lookup then walks memory laid out in the order it visits
+// it. The tree stays usable: later inserts allocate separately as usual.
+// Returns 0 if the block could not be allocated, leaving the tree as it was.
+int radix_compact(RadixTree *tree, RadixMemoryStats *before, RadixMemoryStats *after) {
+    if (!tree || tree->frozen) return 0;
+    
+    RadixMemoryStats stats;
+    radix_memory_usage(tree, &stats);
+    if (before) {
+        *before = stats;
+    }
+    
+    size_t size = sizeof(RadixBlock) + stats.node_bytes + stats.key_bytes;
+    RadixBlock *block = (RadixBlock*)malloc(size);
+    if (!block) return 0;
+    block->next = NULL;
+    block->size = size;
+    
+    if (tree->root) {
+        RadixNode *next_node = (RadixNode*)(block + 1);
+        char *next_key = (char*)(next_node + stats.nodes);
+        tree->root = radix_compact_recursive(tree->root, &next_node, &next_key);
+    }
+    
+    while (tree->blocks) {
+        RadixBlock *next = tree->blocks->next;
+        free(tree->blocks);
+        tree->blocks = next;
+    }
+    tree->blocks = block;
+    
+    if (after) {
+        radix_memory_usage(tree, after);
+    }
+    return 1;
+}
+
+// Make the tree a cache holding at most budget bytes of nodes and keys,
+// counted like node_bytes plus key_bytes in radix_memory_usage, or lift the
+// limit with a budget of 0. Every node then keeps the size of its subtree,
+// so the total is always at hand. Keys are evicted by a CLOCK sweep in key
+// order: searches mark a key as used; inserted keys start unmarked. The
+// hand clears the mark on a used key and evicts an unused one. Each insert
+// moves the hand at most RADIX_CLOCK_STEPS times, so the tree gets back
+// under budget over the following inserts rather than in one long pause.
+// on_evict, if not NULL, is called with every evicted key and its value.
+// Returns 1 on success; a tree over the new budget is brought under it
+// right away.
+int radix_set_budget(RadixTree *tree, size_t budget, void (*on_evict)(const char*, void*)) {
+    if (!tree || tree->frozen) return 0;
+    
+    bool was_tracking = tree->budget != 0;
+    tree->budget = budget;
+    tree->on_evict = on_evict;
+    if (!budget) return 1;
+    
+    if (!was_tracking) {
+        radix_update_aggregates_recursive(tree, tree->root);
+    }
+    int evicted;
+    do {
+        evicted = radix_evict(tree, RADIX_CLOCK_STEPS);
+    } while (evicted > 0);
+    return 1;
+}
+
+// Bytes of nodes and keys in the tree, kept up to date in trees with a budget
+size_t radix_used_bytes(RadixTree *tree) {
+    if (!tree || !tree->root) return 0;
+    if (tree->budget) return tree->root->bytes;
+    
+    RadixMemoryStats stats;
+    radix_memory_usage(tree, &stats);
+    return stats.node_bytes + stats.key_bytes;
+}
+
+// Find the first key of a subtree that sorts after 'after', which is given
+// relative to the subtree, or the subtree's first key if 'after' is NULL.
+// The key is written to path from path_len on, and its length to *key_len.
+static RadixNode* radix_clock_next(RadixNode *node, const char *after, char *path, int path_len, int *key_len) {
+    if (!node) return NULL;
+    
+    int node_key_len = node->key_len;
+    if (path_len + node_key_len >= MAX_KEY_LENGTH) return NULL;
+    memcpy(path + path_len, node->key, node_key_len);
+    path_len += node_key_len;
+    
+    if (after) {
+        int common_len = find_common_prefix_length(node->key, after);
+        if (common_len < node_key_len) {
+            // 'after' leaves the tree in this segment, before or after the whole subtree
+            if ((unsigned char)after[common_len] > (unsigned char)node->key[common_len]) return NULL;
+            after = NULL;
+        } else {
+            after += node_key_len;
+        }
+    }
+    
+    // The node's own key is 'after' or a prefix of it, so it only counts without one
+    int first = 0;
+    if (!after) {
+        if (node->is_terminal) {
+            *key_len = path_len;
+            return node;
+        }
+    } else if (after[0]) {
+        first = (unsigned char)after[0];
+        RadixNode *found = radix_clock_next(node->children[first], after, path, path_len, key_len);
+        if (found) return found;
+        first++;
+    }
+    
+    for (int i = first; i < MAX_CHILDREN; i++) {
+        RadixNode *found = radix_clock_next(node->children[i], NULL, path, path_len, key_len);
+        if (found) return found;
+    }
+    return NULL;
+}
+
+// Move the clock hand to the next key, wrapping around after the last one.
+// A key used since the hand last passed gets a second chance: the mark is
+// cleared and the key stays. Otherwise, or if force is set, the key is
+// evicted, unless it is keep (a stored key that must stay). Returns 1 if a
+// key was evicted.
+static int radix_clock_step(RadixTree *tree, bool force, const char *keep) {
+    char key[MAX_KEY_LENGTH];
+    int key_len = 0;
+    RadixNode *node = NULL;
+    if (tree->clock_hand) {
+        node = radix_clock_next(tree->root, tree->clock_hand, key, 0, &key_len);
+    }
+    if (!node) {
+        node = radix_clock_next(tree->root, NULL, key, 0, &key_len);
+        if (!node) return 0;
+    }
+    key[key_len] = '\0';
+    
+    if (!tree->clock_hand) {
+        tree->clock_hand = (char*)malloc(MAX_KEY_LENGTH);
+        if (!tree->clock_hand) return 0;
+    }
+    memcpy(tree->clock_hand, key, key_len + 1);
+    
+    if ((node->referenced && !force) || (keep && strcmp(key, keep) == 0)) {
+        node->referenced = false;
+        return 0;
+    }
+    
+    void *value = node->value;
+    int deleted = 0;
+    tree->root = radix_delete_recursive(tree, tree->root, key, &deleted);
+    tree->size -= deleted;
+    radix_key_flip(tree->key_mode, key, key_len);
+    if (tree->changes) {
+        radix_change_record(tree, key, NULL, true);
+    }
+    if (tree->on_evict) {
+        tree->on_evict(key, value);
+    }
+    return deleted;
+}
+
+// Move the clock hand while the tree is over budget, at most max_steps times
+static int radix_evict_steps(RadixTree *tree, int max_steps, const char *keep) {
+    int evicted = 0;
+    for (int step = 0; step < max_steps && tree->size > 0 && radix_used_bytes(tree) > tree->budget; step++) {
+        // The last move evicts whatever it finds, so an over-budget tree always shrinks
+        evicted += radix_clock_step(tree, step == max_steps - 1, keep);
+    }
+    return evicted;
+}
+
+// Evict keys from a tree that is over budget, moving the clock hand at most
+// max_steps times. Callers can run this when idle to take eviction work off
+// later inserts. Returns the number of keys evicted.
+int radix_evict(RadixTree *tree, int max_steps) {
+    if (!tree || tree->frozen || !tree->budget) return 0;
+    
+    return radix_evict_steps(tree, max_steps, NULL);
+}
+
+// Keep the last capacity changes made to the tree, so copies of it can be
+// brought up to date with radix_export_changes and radix_apply_changes
+// instead of a full traversal. Inserts, deletes, their batched forms and
+// evictions are logged, each under the next sequence number. Set operations
+// are not; they drop the logged changes, so copies must start over. A
+// capacity of 0 turns the feed off. Returns 1 on success.
+int radix_set_change_feed(RadixTree *tree, int capacity) {
+    if (!tree || capacity < 0) return 0;
+    
+    if (tree->changes) {
+        for (int i = 0; i < tree->change_capacity; i++) {
+            free(tree->changes[i].key);
+        }
+        free(tree->changes);
+        tree->changes = NULL;
+        tree->change_capacity = 0;
+    }
+    tree->change_oldest = tree->change_seq;
+    if (capacity == 0) return 1;
+    
+    tree->changes = (RadixLogEntry*)calloc(capacity, sizeof(RadixLogEntry));
+    if (!tree->changes) return 0;
+    tree->change_capacity = capacity;
+    return 1;
+}
+
+// Sequence number the next change will get. A copy made by traversing the
+// tree is current up to here.
+uint64_t radix_change_seq(RadixTree *tree) {
+    return tree ? tree->change_seq : 0;
+}
+
+// Forget the logged changes after a change that could not be logged (out
+// of memory, or a key too long for a batch), so copies asking for anything
+// before it are told to start over
+static void radix_change_reset(RadixTree *tree) {
+    if (!tree->changes) return;
+    
+    tree->change_seq++;
+    tree->change_oldest = tree->change_seq;
+}
+
+// Log one change in the ring, overwriting the oldest once it is full. key
+// is in the caller's form.
+static void radix_change_record(RadixTree *tree, const char *key, void *value, bool is_delete) {
+    char *copy = strlen(key) < MAX_KEY_LENGTH ? strdup(key) : NULL;
+    if (!copy) {
+        radix_change_reset(tree);
+        return;
+    }
+    
+    // The caller's copy of an interned value may not outlive the call
+    if (tree->values && value && !is_delete) {
+        value = (void*)radix_value_by_id(tree, radix_intern_value(tree, value));
+    }
+    
+    RadixLogEntry *entry = &tree->changes[tree->change_seq % tree->change_capacity];
+    free(entry->key);
+    entry->key = copy;
+    entry->value = value;
+    entry->is_delete = is_delete;
+    tree->change_seq++;
+    if (tree->change_seq - tree->change_oldest > (uint64_t)tree->change_capacity) {
+        tree->change_oldest = tree->change_seq - tree->change_capacity;
+    }
+}
+
+// Write the changes from sequence number since on into a new buffer, at
+// most max_changes of them (0 for all). The caller frees *data.
+//
+// A batch holds a header of "RDXC", the value size (uint32, 0 when values
+// are pointers), the first and next sequence numbers (uint64 each) and
+// the change count (uint32), then each change as one byte (0 delete, 1
+// insert, 2 insert of NULL), the key length (uint16), the key and, for an
+// insert, the value. Interned trees write their value bytes, so batches
+// can go to other processes or to disk; other trees write the pointers,
+// which only mean something in the same process. Numbers are in host
+// byte order.
+//
+// Returns the number of changes written, or -1 if the feed is off, since
+// is ahead of the tree, or the changes since then have been dropped (the
+// copy must then be rebuilt from a traversal).
+int radix_export_changes(RadixTree *tree, uint64_t since, int max_changes, char **data, size_t *size) {
+    if (!tree || !tree->changes || !data || !size) return -1;
+    if (since < tree->change_oldest || since > tree->change_seq) return -1;
+    
+    uint64_t end = tree->change_seq;
+    if (max_changes > 0 && end - since > (uint64_t)max_changes) {
+        end = since + max_changes;
+    }
+    uint32_t value_size = tree->values ? (uint32_t)tree->values->value_size : 0;
+    size_t value_bytes = value_size ? value_size : sizeof(void*);
+    
+    size_t total = RADIX_CHANGES_HEADER;
+    for (uint64_t seq = since; seq < end; seq++) {
+        RadixLogEntry *entry = &tree->changes[seq % tree->change_capacity];
+        total += 3 + strlen(entry->key);
+        if (!entry->is_delete && entry->value) {
+            total += value_bytes;
+        }
+    }
+    
+    char *buf = (char*)malloc(total);
+    if (!buf) return -1;
+    
+    uint32_t count = (uint32_t)(end - since);
+    memcpy(buf, RADIX_CHANGES_MAGIC, 4);
+    memcpy(buf + 4, &value_size, 4);
+    memcpy(buf + 8, &since, 8);
+    memcpy(buf + 16, &end, 8);
+    memcpy(buf + 24, &count, 4);
+    
+    char *cursor = buf + RADIX_CHANGES_HEADER;
+    for (uint64_t seq = since; seq < end; seq++) {
+        RadixLogEntry *entry = &tree->changes[seq % tree->change_capacity];
+        uint16_t key_len = (uint16_t)strlen(entry->key);
+        *cursor++ = entry->is_delete ? 0 : entry->value ? 1 : 2;
+        memcpy(cursor, &key_len, 2);
+        memcpy(cursor + 2, entry->key, key_len);
+        cursor += 2 + key_len;
+        if (!entry->is_delete && entry->value) {
+            memcpy(cursor, value_size ? entry->value : (void*)&entry->value, value_bytes);
+            cursor += value_bytes;
+        }
+    }
+    
+    *data = buf;
+    *size = total;
+    return (int)count;
+}
+
+// Apply a batch made by radix_export_changes to a copy of the tree. *seq
+// is the copy's position, the next sequence number it needs, and is
+// advanced past the batch. Changes the copy already has are skipped. Runs
+// of inserts and of deletes go in as one batched update each, so the work
+// follows the number of changes, not the size of the tree. Returns the
+// number of changes applied, or -1 if the batch is malformed, starts after
+// *seq (changes are missing) or holds values of another size. Nothing is
+// applied from a batch that is rejected.
+int radix_apply_changes(RadixTree *tree, const char *data, size_t size, uint64_t *seq) {
+    if (!tree || tree->frozen || !data || !seq || size < RADIX_CHANGES_HEADER) return -1;
+    if (memcmp(data, RADIX_CHANGES_MAGIC, 4) != 0) return -1;
+    
+    uint32_t value_size, count;
+    uint64_t first, next;
+    memcpy(&value_size, data + 4, 4);
+    memcpy(&first, data + 8, 8);
+    memcpy(&next, data + 16, 8);
+    memcpy(&count, data + 24, 4);
+    if (value_size != (tree->values ? tree->values->value_size : 0)) return -1;
+    if (next < first || next - first != count || first > *seq) return -1;
+    size_t value_bytes = value_size ? value_size : sizeof(void*);
+    
+    // Check the whole batch before changing anything
+    const char *cursor = data + RADIX_CHANGES_HEADER;
+    const char *limit = data + size;
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t key_len;
+        if (limit - cursor < 3 || (unsigned char)cursor[0] > 2) return -1;
+        memcpy(&key_len, cursor + 1, 2);
+        if (key_len >= MAX_KEY_LENGTH) return -1;
+        size_t record = 3 + key_len + (cursor[0] == 1 ? value_bytes : 0);
+        if ((size_t)(limit - cursor) < record) return -1;
+        cursor += record;
+    }
+    if (cursor != limit) return -1;
+    if (*seq >= next) return 0;
+    
+    // Keys are copied out to be terminated; each record is longer than its key
+    const char **keys = (const char**)malloc(count * (sizeof(char*) + sizeof(void*)) + size);
+    if (!keys) return -1;
+    void **values = (void**)(keys + count);
+    char *staged = (char*)(values + count);
+    
+    int applied = 0;
+    int run_start = 0;
+    int run_length = 0;
+    bool run_deletes = false;
+    cursor = data + RADIX_CHANGES_HEADER;
+    for (uint32_t i = 0; i <= count; i++) {
+        unsigned char op = 0;
+        uint16_t key_len = 0;
+        if (i < count) {
+            op = (unsigned char)cursor[0];
+            memcpy(&key_len, cursor + 1, 2);
+        }
+        
+        // Flush the run when the kind of change switches, so updates of a key keep their order
+        if (run_length > 0 && (i == count || (op == 0) != run_deletes)) {
+            if (run_deletes) {
+                radix_delete_batch(tree, keys + run_start, run_length, false);
+            } else {
+                radix_insert_batch(tree, keys + run_start, values + run_start, run_length, false);
+            }
+            applied += run_length;
+            run_start += run_length;
+            run_length = 0;
+        }
+        if (i == count) break;
+        
+        const char *key = cursor + 3;
+        cursor += 3 + key_len + (op == 1 ? value_bytes : 0);
+        if (first + i < *seq) continue;
+        
+        memcpy(staged, key, key_len);
+        staged[key_len] = '\0';
+        keys[run_start + run_length] = staged;
+        staged += key_len + 1;
+        values[run_start + run_length] = NULL;
+        if (op == 1) {
+            if (value_size) {
+                values[run_start + run_length] = (void*)(key + key_len);
+            } else {
+                memcpy(&values[run_start + run_length], key + key_len, sizeof(void*));
+            }
+        }
+        run_deletes = op == 0;
+        run_length++;
+    }
+    
+    free(keys);
+    *seq = next;
+    return applied;
+}
+
+#if __cplusplus >= 202002L
+// A lookup running as a coroutine, made by async_search. It starts
+// suspended; whoever drives it calls resume() until done() and then reads
+// result(). Each resume advances the lookup by one tree level.
+struct RadixSearchTask {
+    struct promise_type {
+        void *result = NULL;
+        
+        RadixSearchTask get_return_object() {
+            return RadixSearchTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(void *value) { result = value; }
+        void unhandled_exception() { abort(); }
+
+    };
+    
+    std::coroutine_handle<promise_type> handle;
+    
+    RadixSearchTask() : handle(NULL) {}
+    explicit RadixSearchTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+    RadixSearchTask(RadixSearchTask &&other) noexcept : handle(other.handle) { other.handle = NULL; }
+    RadixSearchTask& operator=(RadixSearchTask &&other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = NULL;
+        }
+        return *this;
+    }
+    RadixSearchTask(const RadixSearchTask&) = delete;
+    RadixSearchTask& operator=(const RadixSearchTask&) = delete;
+    ~RadixSearchTask() {
+        if (handle) handle.destroy();
+    }
+    
+    bool done() const { return !handle || handle.done(); }
+    void resume() { handle.resume(); }
+    void* result() const { return handle ? handle.promise().result : NULL; }
+};
+
+// Starts loading an address into the cache and suspends, so other lookups
+// can run while the load is in flight
+struct RadixPrefetch {
+    const void *address;
+    
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const noexcept { __builtin_prefetch(address); }
+    void await_resume() const noexcept {}
+};
+
+// Coroutine behind async_search, for a key in the stored form
+static RadixSearchTask radix_async_search_stored(RadixTree *tree, const char *key) {
+    if (!tree || !key) co_return NULL;
+    
+    int key_len = strlen(key);
+    int depth = 0;
+    void *value = NULL;
+    RadixNode *node = tree->root;
+    while (node) {
+        co_await RadixPrefetch{node};
+        node = radix_search_step(tree, node, key, key_len, &depth, &value);
+    }
+    co_return value;
+}
+
+// Same for trees storing converted keys, whose frame holds the converted copy
+static RadixSearchTask radix_async_search_converted(RadixTree *tree, const char *key) {
+    char stored[MAX_KEY_LENGTH];
+    key = radix_key_encode(tree, key, stored);
+    if (!key) co_return NULL;
+    
+    int key_len = strlen(key);
+    int depth = 0;
+    void *value = NULL;
+    RadixNode *node = tree->root;
+    while (node) {
+        co_await RadixPrefetch{node};
+        node = radix_search_step(tree, node, key, key_len, &depth, &value);
+    }
+    co_return value;
+}
+
+// Search for a key as a coroutine. Before each node it prefetches the node
+// and suspends, then runs the same step as radix_search on it.
+// key must stay valid until the task is done.
+RadixSearchTask async_search(RadixTree *tree, const char *key) {
+    if (tree && key && tree->key_mode != RADIX_KEYS_FORWARD) return radix_async_search_converted(tree, key);
+    return radix_async_search_stored(tree, key);
+}
+
+// Look up count keys on the calling thread with up to width lookups in
+// flight, resuming them round-robin so their cache misses overlap.
+// results[i] receives the value of keys[i], or NULL. Returns the number
+// of keys found.
+int radix_search_interleaved(RadixTree *tree, const char **keys, int count, void **results, int width) {
+    if (!tree || !keys || !results || count <= 0) return 0;
+    if (width < 1) width = 1;
+    if (width > count) width = count;
+    
+    RadixSearchTask *tasks = new RadixSearchTask[width];
+    int *slot_key = (int*)malloc(width * sizeof(int));
+    int next_key = 0;
+    int running = 0;
+    int found = 0;
+    
+    for (int i = 0; i < width; i++) {
+        tasks[i] = async_search(tree, keys[next_key]);
+        slot_key[i] = next_key++;
+        running++;
+    }
+    
+    while (running > 0) {
+        for (int i = 0; i < width; i++) {
+            if (!tasks[i].handle) continue;
+            
+            tasks[i].resume();
+            if (!tasks[i].done()) continue;
+            
+            results[slot_key[i]] = tasks[i].result();
+            if (results[slot_key[i]]) found++;
+            
+            // Reuse the slot for the next key
+            if (next_key < count) {
+                tasks[i] = async_search(tree, keys[next_key]);
+                slot_key[i] = next_key++;
+            } else {
+                tasks[i] = RadixSearchTask();
+                running--;
+            }
+        }
+    }
+    
+    free(slot_key);
+    delete[] tasks;
+    return found;
+}
+#endif
+
+// Print the radix tree structure
+void radix_print(RadixTree *tree) {
+    if (!tree) return;
+    
+    printf("Radix Tree (size: %d):\n", tree->size);
+    char prefix[MAX_KEY_LENGTH];
+    radix_print_recursive(tree->root, prefix, 0, 0, tree->key_mode);
+}
+
+// Recursive helper for printing tree structure
+static void radix_print_recursive(RadixNode *node, char *prefix, int prefix_len, int depth, RadixKeyMode mode) {
+    if (!node) return;
+    
+    // Print indentation
+    for (int i = 0; i < depth; i++) {
+        printf("  ");
+    }
+    
+    // Add current node's key to prefix
+    int key_len = node->key_len;
+    strcpy(prefix + prefix_len, node->key);
+    int new_prefix_len = prefix_len + key_len;
+    prefix[new_prefix_len] = '\0';
     
     // Print node information
     if (node->is_terminal) {
+        radix_key_flip(mode, prefix, new_prefix_len);
         printf("'%s' -> %p (terminal)\n", prefix, node->value);
+        radix_key_flip(mode, prefix, new_prefix_len);
     } else {
         printf("'%s' (internal)\n", node->key);
     }
     
-    // Recurse on children
+    // Recurse on children
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            radix_print_recursive(node->children[i], prefix, new_prefix_len, depth + 1, mode);
+        }
+    }
+}
+
+// Start or stop keeping subtree key counts. With counts, radix_count_prefix,
+// radix_rank and radix_select take one descent instead of a subtree walk.
+void radix_set_track_counts(RadixTree *tree, bool enabled) {
+    if (!tree || tree->frozen || tree->track_counts == enabled) return;
+    
+    tree->track_counts = enabled;
+    if (enabled) {
+        radix_update_aggregates_recursive(tree, tree->root);
+    }
+}
+
+// Number of keys in a subtree, by walking it when counts are not kept
+static int radix_subtree_count(RadixTree *tree, RadixNode *node) {
+    if (!node) return 0;
+    if (tree->track_counts) return node->key_count;
+    
+    int count = node->is_terminal ? 1 : 0;
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        count += radix_subtree_count(tree, node->children[i]);
+    }
+    return count;
+}
+
+// Count the keys starting with prefix
+int radix_count_prefix(RadixTree *tree, const char *prefix) {
+    if (!tree || !prefix) return 0;
+    
+    char stored[MAX_KEY_LENGTH];
+    prefix = radix_key_encode(tree, prefix, stored);
+    if (!prefix) return 0;
+    
+    char path[MAX_KEY_LENGTH];
+    int path_len = 0;
+    return radix_subtree_count(tree, radix_find_prefix_node(tree->root, prefix, path, &path_len));
+}
+
+// Count the keys that sort before key, which need not be in the tree.
+// This is the position key has or would have in radix_traverse order.
+int radix_rank(RadixTree *tree, const char *key) {
+    if (!tree || !key) return 0;
+    
+    char stored[MAX_KEY_LENGTH];
+    key = radix_key_encode(tree, key, stored);
+    if (!key) return 0;
+    
+    int rank = 0;
+    RadixNode *node = tree->root;
+    while (node) {
+        int common_len = find_common_prefix_length(node->key, key);
+        if (common_len < node->key_len) {
+            // key leaves the tree inside this segment, before or after the whole subtree
+            if ((unsigned char)key[common_len] > (unsigned char)node->key[common_len]) {
+                rank += radix_subtree_count(tree, node);
+            }
+            break;
+        }
+        
+        key += common_len;
+        if (key[0] == '\0') break;
+        
+        // The node's own key is a proper prefix of key, and so are smaller children
+        if (node->is_terminal) {
+            rank++;
+        }
+        unsigned char first_char = (unsigned char)key[0];
+        for (int i = 0; i < first_char; i++) {
+            rank += radix_subtree_count(tree, node->children[i]);
+        }
+        node = node->children[first_char];
+    }
+    return rank;
+}
+
+// Find the key at position index (from 0) in radix_traverse order. The key
+// is written to key, a buffer of MAX_KEY_LENGTH characters, and its value
+// to *value if value is not NULL. Returns 0 if index is out of range.
+int radix_select(RadixTree *tree, int index, char *key, void **value) {
+    if (!tree || !key || index < 0) return 0;
+    
+    int key_len = 0;
+    RadixNode *node = tree->root;
+    while (node) {
+        if (key_len + node->key_len >= MAX_KEY_LENGTH) return 0;
+        memcpy(key + key_len, node->key, node->key_len + 1);
+        key_len += node->key_len;
+        
+        if (node->is_terminal) {
+            if (index == 0) {
+                if (value) {
+                    *value = node->value;
+                }
+                radix_key_flip(tree->key_mode, key, key_len);
+                return 1;
+            }
+            index--;
+        }
+        
+        // Skip whole subtrees until the one holding the key
+        RadixNode *next = NULL;
+        for (int i = 0; i < MAX_CHILDREN && !next; i++) {
+            int count = radix_subtree_count(tree, node->children[i]);
+            if (index < count) {
+                next = node->children[i];
+            } else {
+                index -= count;
+            }
+        }
+        node = next;
+    }
+    return 0;
+}
+
+// Refresh the score of a key after its value was modified in place
+int radix_rescore(RadixTree *tree, const char *key) {
+    if (!tree || tree->frozen || !key || !tree->score_fn) return 0;
+    
+    void *value = radix_search(tree, key);
+    if (!value) return 0;
+    
+    // Re-inserting the same value refreshes the maxima along the key's path
+    radix_insert(tree, key, value);
+    return 1;
+}
+
+// Find the node whose subtree holds every key starting with prefix.
+// The full key spelled up to and including that node is written to path.
+static RadixNode* radix_find_prefix_node(RadixNode *node, const char *prefix, char *path, int *path_len) {
+    while (node) {
+        int common_len = find_common_prefix_length(node->key, prefix);
+        int node_key_len = node->key_len;
+        int prefix_len = strlen(prefix);
+        
+        if (*path_len + node_key_len >= MAX_KEY_LENGTH) return NULL;
+        strcpy(path + *path_len, node->key);
+        *path_len += node_key_len;
+        
+        if (common_len == prefix_len) {
+            return node;
+        }
+        if (common_len < node_key_len) {
+            return NULL;
+        }
+        
+        prefix += common_len;
+        node = node->children[(unsigned char)prefix[0]];
+    }
+    
+    return NULL;
+}
+
+// Entry of the best-first queue used by radix_topk
+typedef struct {
+    double score;      // Own score when emit is set, subtree maximum otherwise
+    RadixNode *node;
+    char *key;         // Full key up to and including node->key
+    bool emit;         // Report node's value instead of expanding its subtree
+} RadixTopkEntry;
+
+typedef struct {
+    RadixTopkEntry *entries;
+    int size;
+    int capacity;
+} RadixTopkHeap;
+
+static void radix_topk_push(RadixTopkHeap *heap, double score, RadixNode *node, char *key, bool emit) {
+    RadixTopkEntry entry;
+    entry.score = score;
+    entry.node = node;
+    entry.key = key;
+    entry.emit = emit;
+    
+    if (heap->size == heap->capacity) {
+        heap->capacity = heap->capacity ? heap->capacity * 2 : 64;
+        heap->entries = (RadixTopkEntry*)realloc(heap->entries, heap->capacity * sizeof(RadixTopkEntry));
+    }
+    
+    int i = heap->size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap->entries[parent].score >= entry.score) break;
+        heap->entries[i] = heap->entries[parent];
+        i = parent;
+    }
+    heap->entries[i] = entry;
+}
+
+// Order queue entries best first
+static int radix_topk_entry_compare(const void *a, const void *b) {
+    double score_a = ((const RadixTopkEntry*)a)->score;
+    double score_b = ((const RadixTopkEntry*)b)->score;
+    return (score_a < score_b) - (score_a > score_b);
+}
+
+// Keep only the best keep entries of the queue. Every entry stands for at
+// least one key scoring its score (a subtree reaches its maximum somewhere),
+// and entries never share keys, so the keep best of them already hold keep
+// keys that score at least as well as anything in the dropped ones. A
+// sorted array is a valid heap, so no rebuilding is needed.
+static void radix_topk_trim(RadixTopkHeap *heap, int keep) {
+    qsort(heap->entries, heap->size, sizeof(RadixTopkEntry), radix_topk_entry_compare);
+    for (int i = keep; i < heap->size; i++) {
+        free(heap->entries[i].key);
+    }
+    heap->size = keep;
+}
+
+static RadixTopkEntry radix_topk_pop(RadixTopkHeap *heap) {
+    RadixTopkEntry top = heap->entries[0];
+    RadixTopkEntry last = heap->entries[--heap->size];
+    
+    int i = 0;
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= heap->size) break;
+        if (child + 1 < heap->size && heap->entries[child + 1].score > heap->entries[child].score) {
+            child++;
+        }
+        if (last.score >= heap->entries[child].score) break;
+        heap->entries[i] = heap->entries[child];
+        i = child;
+    }
+    if (heap->size > 0) {
+        heap->entries[i] = last;
+    }
+    return top;
+}
+
+// Report the k best scored keys starting with prefix, best first.
+// Subtrees are expanded in order of their maximum score, so only the
+// branches that can still contain one of the k best keys are visited.
+// Once the queue holds twice as many entries as keys are still to be
+// reported, the worse half is dropped, which keeps it within O(k).
+int radix_topk(RadixTree *tree, const char *prefix, int k, void (*callback)(const char*, void*)) {
+    if (!tree || !prefix || !callback || !tree->score_fn || k <= 0) return 0;
+    
+    char stored[MAX_KEY_LENGTH];
+    prefix = radix_key_encode(tree, prefix, stored);
+    if (!prefix) return 0;
+    
+    char path[MAX_KEY_LENGTH];
+    int path_len = 0;
+    RadixNode *start = radix_find_prefix_node(tree->root, prefix, path, &path_len);
+    if (!start || start->max_score == -INFINITY) return 0;
+    path[path_len] = '\0';
+    if (k > tree->size) k = tree->size;
+    
+    RadixTopkHeap heap = {NULL, 0, 0};
+    radix_topk_push(&heap, start->max_score, start, strdup(path), false);
+    
+    int reported = 0;
+    while (heap.size > 0 && reported < k) {
+        RadixTopkEntry entry = radix_topk_pop(&heap);
+        
+        if (entry.emit) {
+            radix_key_flip(tree->key_mode, entry.key, strlen(entry.key));
+            callback(entry.key, entry.node->value);
+            reported++;
+            free(entry.key);
+            continue;
+        }
+        
+        RadixNode *node = entry.node;
+        int key_len = strlen(entry.key);
+        
+        if (node->is_terminal) {
+            radix_topk_push(&heap, tree->score_fn(node->value), node, strdup(entry.key), true);
+        }
+        
+        for (int i = 0; i < MAX_CHILDREN; i++) {
+            RadixNode *child = node->children[i];
+            if (!child) continue;
+            
+            int child_key_len = child->key_len;
+            if (key_len + child_key_len >= MAX_KEY_LENGTH) continue;
+            
+            char *child_key = (char*)malloc(key_len + child_key_len + 1);
+            strcpy(child_key, entry.key);
+            strcpy(child_key + key_len, child->key);
+            radix_topk_push(&heap, child->max_score, child, child_key, false);
+        }
+        
+        free(entry.key);
+        if (heap.size >= 2 * (k - reported)) {
+            radix_topk_trim(&heap, k - reported);
+        }
+    }
+    
+    for (int i = 0; i < heap.size; i++) {
+        free(heap.entries[i].key);
+    }
+    free(heap.entries);
+    
+    return reported;
+}
+
+// Find every key within Levenshtein distance max_dist of query.
+// One row of the edit distance table is computed per character of the
+// compressed segments, so keys sharing a prefix share those rows, and a
+// branch is dropped as soon as no cell of its last row is within max_dist.
+// Reversing both strings keeps their distance, so the query is simply
+// converted like a key. In RADIX_KEYS_LABELS trees the distance is that of
+// the label-reversed forms, which only differs for edits around the dots.
+int radix_fuzzy_search(RadixTree *tree, const char *query, int max_dist, void (*callback)(const char*, void*, int)) {
+    if (!tree || !query || !callback || max_dist < 0) return 0;
+    
+    char stored[MAX_KEY_LENGTH];
+    query = radix_key_encode(tree, query, stored);
+    if (!query) return 0;
+    
+    int query_len = strlen(query);
+    int *first_row = (int*)malloc((query_len + 1) * sizeof(int));
+    for (int i = 0; i <= query_len; i++) {
+        first_row[i] = i;
+    }
+    
+    char prefix[MAX_KEY_LENGTH];
+    int found = radix_fuzzy_recursive(tree->root, query, query_len, max_dist, first_row, prefix, 0, tree->key_mode, callback);
+    
+    free(first_row);
+    return found;
+}
+
+// Recursive helper for fuzzy search, prev_row is the table row of the parent's last character
+static int radix_fuzzy_recursive(RadixNode *node, const char *query, int query_len, int max_dist, const int *prev_row,
+                                 char *prefix, int prefix_len, RadixKeyMode mode, void (*callback)(const char*, void*, int)) {
+    if (!node) return 0;
+    
+    int key_len = node->key_len;
+    if (prefix_len + key_len >= MAX_KEY_LENGTH) return 0;
+    
+    int *rows = (int*)malloc(2 * (query_len + 1) * sizeof(int));
+    int *row = rows;
+    memcpy(row, prev_row, (query_len + 1) * sizeof(int));
+    
+    for (int c = 0; c < key_len; c++) {
+        int *next = (row == rows) ? rows + query_len + 1 : rows;
+        char ch = node->key[c];
+        int row_min;
+        
+        next[0] = row[0] + 1;
+        row_min = next[0];
+        for (int i = 1; i <= query_len; i++) {
+            int cost = (query[i - 1] == ch) ? 0 : 1;
+            int best = row[i - 1] + cost;              // Substitution or match
+            if (row[i] + 1 < best) best = row[i] + 1;   // Insertion of ch
+            if (next[i - 1] + 1 < best) best = next[i - 1] + 1;  // Deletion of query[i - 1]
+            next[i] = best;
+            if (best < row_min) row_min = best;
+        }
+        
+        if (row_min > max_dist) {
+            free(rows);
+            return 0;
+        }
+        row = next;
+    }
+    
+    memcpy(prefix + prefix_len, node->key, key_len);
+    int new_prefix_len = prefix_len + key_len;
+    int found = 0;
+    
+    if (node->is_terminal && row[query_len] <= max_dist) {
+        prefix[new_prefix_len] = '\0';
+        radix_key_flip(mode, prefix, new_prefix_len);
+        callback(prefix, node->value, row[query_len]);
+        radix_key_flip(mode, prefix, new_prefix_len);
+        found++;
+    }
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            found += radix_fuzzy_recursive(node->children[i], query, query_len, max_dist, row,
+                                           prefix, new_prefix_len, mode, callback);
+        }
+    }
+    
+    free(rows);
+    return found;
+}
+
+static inline void radix_glob_add_byte(RadixGlobToken *token, unsigned char c) {
+    token->bytes[c >> 6] |= 1ULL << (c & 63);
+}
+
+static inline bool radix_glob_has_byte(const RadixGlobToken *token, unsigned char c) {
+    return (token->bytes[c >> 6] >> (c & 63)) & 1;
+}
+
+// Compile a glob pattern into tokens. Supported are '*' (any run of
+// characters, '/' included), '?' (one character), "[abc]", "[a-z]" and
+// "[!abc]" or "[^abc]" classes, and '\' to take the next character
+// literally. Returns the number of tokens, or -1 for a malformed pattern.
+static int radix_glob_compile(const char *pattern, RadixGlobToken *tokens) {
+    int num_tokens = 0;
+    
+    while (*pattern) {
+        if (*pattern == '*') {
+            // A run of stars matches what one star does
+            if (num_tokens == 0 || !tokens[num_tokens - 1].star) {
+                if (num_tokens == RADIX_GLOB_MAX) return -1;
+                memset(&tokens[num_tokens], 0, sizeof(RadixGlobToken));
+                tokens[num_tokens++].star = true;
+            }
+            pattern++;
+            continue;
+        }
+        
+        if (num_tokens == RADIX_GLOB_MAX) return -1;
+        RadixGlobToken *token = &tokens[num_tokens++];
+        memset(token, 0, sizeof(RadixGlobToken));
+        
+        if (*pattern == '?') {
+            memset(token->bytes, 0xff, sizeof(token->bytes));
+            pattern++;
+        } else if (*pattern == '[') {
+            pattern++;
+            bool negate = (*pattern == '!' || *pattern == '^');
+            if (negate) pattern++;
+            
+            // A ']' right after the opening bracket is a member
+            bool first = true;
+            while (*pattern && (*pattern != ']' || first)) {
+                if (*pattern == '\\' && pattern[1]) pattern++;
+                unsigned char low = (unsigned char)*pattern++;
+                unsigned char high = low;
+                if (pattern[0] == '-' && pattern[1] && pattern[1] != ']') {
+                    pattern++;
+                    if (*pattern == '\\' && pattern[1]) pattern++;
+                    high = (unsigned char)*pattern++;
+                }
+                for (int c = low; c <= high; c++) {
+                    radix_glob_add_byte(token, c);
+                }
+                first = false;
+            }
+            if (*pattern != ']') return -1;
+            pattern++;
+            
+            if (negate) {
+                for (int w = 0; w < 4; w++) {
+                    token->bytes[w] = ~token->bytes[w];
+                }
+            }
+        } else {
+            if (*pattern == '\\' && pattern[1]) pattern++;
+            radix_glob_add_byte(token, (unsigned char)*pattern++);
+        }
+    }
+    return num_tokens;
+}
+
+// Add the positions reachable without reading a character, by skipping stars
+static void radix_glob_closure(const RadixGlobToken *tokens, int num_tokens, uint64_t *states) {
+    for (int i = 0; i < num_tokens; i++) {
+        if (tokens[i].star && ((states[i >> 6] >> (i & 63)) & 1)) {
+            states[(i + 1) >> 6] |= 1ULL << ((i + 1) & 63);
+        }
+    }
+}
+
+// Advance a set of pattern positions by one character. Returns false when
+// no position is left, so nothing below can match.
+static bool radix_glob_step(const RadixGlobToken *tokens, int num_tokens, const uint64_t *from, uint64_t *to, unsigned char c) {
+    memset(to, 0, RADIX_GLOB_WORDS * sizeof(uint64_t));
+    
+    for (int w = 0; w < RADIX_GLOB_WORDS; w++) {
+        uint64_t bits = from[w];
+        while (bits) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (i == num_tokens) continue;
+            
+            if (tokens[i].star) {
+                to[i >> 6] |= 1ULL << (i & 63);
+            } else if (radix_glob_has_byte(&tokens[i], c)) {
+                to[(i + 1) >> 6] |= 1ULL << ((i + 1) & 63);
+            }
+        }
+    }
+    radix_glob_closure(tokens, num_tokens, to);
+    
+    uint64_t any = 0;
+    for (int w = 0; w < RADIX_GLOB_WORDS; w++) {
+        any |= to[w];
+    }
+    return any != 0;
+}
+
+// Find the keys matching a glob pattern (see radix_glob_compile). The
+// pattern runs as an automaton over sets of pattern positions, driven
+// down the tree one segment at a time, so a shared prefix is matched once
+// for all the keys below it. A branch is dropped as soon as no position is
+// left, and once a trailing '*' is reached the whole subtree is reported
+// without further matching. Returns the number of matches, or -1 for a
+// malformed pattern. In RADIX_KEYS_REVERSED trees the compiled pattern is
+// reversed to match the stored keys; in RADIX_KEYS_LABELS trees the pattern
+// applies to the label-reversed form, such as "com.example.*".
+int radix_match_pattern(RadixTree *tree, const char *pattern, void (*callback)(const char*, void*)) {
+    if (!tree || !pattern || !callback) return 0;
+    
+    RadixGlobToken *tokens = (RadixGlobToken*)malloc(RADIX_GLOB_MAX * sizeof(RadixGlobToken));
+    if (!tokens) return 0;
+    
+    int num_tokens = radix_glob_compile(pattern, tokens);
+    if (num_tokens < 0) {
+        free(tokens);
+        return -1;
+    }
+    if (tree->key_mode == RADIX_KEYS_REVERSED) {
+        for (int i = 0, j = num_tokens - 1; i < j; i++, j--) {
+            RadixGlobToken token = tokens[i];
+            tokens[i] = tokens[j];
+            tokens[j] = token;
+        }
+    }
+    
+    uint64_t states[RADIX_GLOB_WORDS] = {0};
+    states[0] = 1;
+    radix_glob_closure(tokens, num_tokens, states);
+    
+    char prefix[MAX_KEY_LENGTH];
+    int found = radix_match_recursive(tree->root, tokens, num_tokens, states, prefix, 0, tree->key_mode, callback);
+    
+    free(tokens);
+    return found;
+}
+
+// Recursive helper for pattern matching, states are the pattern positions
+// reached by the key spelled above node
+static int radix_match_recursive(RadixNode *node, const RadixGlobToken *tokens, int num_tokens, const uint64_t *states,
+                                 char *prefix, int prefix_len, RadixKeyMode mode, void (*callback)(const char*, void*)) {
+    if (!node) return 0;
+    
+    int last = num_tokens - 1;
+    if (last >= 0 && tokens[last].star && ((states[last >> 6] >> (last & 63)) & 1)) {
+        // The pattern ends in a star that is already reached, so every key below matches
+        return radix_traverse_recursive(node, prefix, prefix_len, mode, callback);
+    }
+    
+    int key_len = node->key_len;
+    if (prefix_len + key_len >= MAX_KEY_LENGTH) return 0;
+    
+    uint64_t sets[2][RADIX_GLOB_WORDS];
+    const uint64_t *current = states;
+    for (int c = 0; c < key_len; c++) {
+        uint64_t *next = sets[c & 1];
+        if (!radix_glob_step(tokens, num_tokens, current, next, (unsigned char)node->key[c])) return 0;
+        current = next;
+    }
+    
+    memcpy(prefix + prefix_len, node->key, key_len);
+    int new_prefix_len = prefix_len + key_len;
+    int found = 0;
+    
+    if (node->is_terminal && ((current[num_tokens >> 6] >> (num_tokens & 63)) & 1)) {
+        prefix[new_prefix_len] = '\0';
+        radix_key_flip(mode, prefix, new_prefix_len);
+        callback(prefix, node->value);
+        radix_key_flip(mode, prefix, new_prefix_len);
+        found++;
+    }
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            found += radix_match_recursive(node->children[i], tokens, num_tokens, current, prefix, new_prefix_len, mode, callback);
+        }
+    }
+    return found;
+}
+
+// Recursive helper for radix_scan_suffix in forward trees, which has to
+// look at the end of every key
+static int radix_scan_suffix_recursive(RadixNode *node, char *prefix, int prefix_len, const char *suffix, int suffix_len,
+                                       void (*callback)(const char*, void*)) {
+    if (!node) return 0;
+    
+    int key_len = node->key_len;
+    if (prefix_len + key_len >= MAX_KEY_LENGTH) return 0;
+    
+    memcpy(prefix + prefix_len, node->key, key_len);
+    int new_prefix_len = prefix_len + key_len;
+    int found = 0;
+    
+    if (node->is_terminal && new_prefix_len >= suffix_len &&
+        memcmp(prefix + new_prefix_len - suffix_len, suffix, suffix_len) == 0) {
+        prefix[new_prefix_len] = '\0';
+        callback(prefix, node->value);
+        found++;
+    }
+    
     for (int i = 0; i < MAX_CHILDREN; i++) {
         if (node->children[i]) {
-            radix_print_recursive(node->children[i], prefix, new_prefix_len, depth + 1);
+            found += radix_scan_suffix_recursive(node->children[i], prefix, new_prefix_len, suffix, suffix_len, callback);
+        }
+    }
+    return found;
+}
+
+// Report the keys ending with suffix. In reversed and label trees the
+// stored forms of these keys start with the stored form of suffix, so this
+// is one descent plus a walk of the keys found, like a prefix query;
+// forward trees check every key. In RADIX_KEYS_LABELS trees suffix is
+// matched by whole labels: "example.com" matches itself and
+// "a.example.com" but not "myexample.com", and ".log" matches the keys
+// whose last label is "log". Returns the number of keys reported.
+int radix_scan_suffix(RadixTree *tree, const char *suffix, void (*callback)(const char*, void*)) {
+    if (!tree || !suffix || !callback) return 0;
+    
+    char prefix[MAX_KEY_LENGTH];
+    if (tree->key_mode == RADIX_KEYS_FORWARD) {
+        return radix_scan_suffix_recursive(tree->root, prefix, 0, suffix, strlen(suffix), callback);
+    }
+    
+    char stored[MAX_KEY_LENGTH];
+    suffix = radix_key_encode(tree, suffix, stored);
+    if (!suffix) return 0;
+    
+    int suffix_len = strlen(suffix);
+    int path_len = 0;
+    RadixNode *node = radix_find_prefix_node(tree->root, suffix, prefix, &path_len);
+    if (!node) return 0;
+    
+    // A label suffix has to be followed by a dot or the end of the key,
+    // unless it brings its own dot
+    if (tree->key_mode == RADIX_KEYS_LABELS && suffix_len > 0 && suffix[suffix_len - 1] != '.') {
+        if (path_len > suffix_len) {
+            if (prefix[suffix_len] != '.') return 0;
+        } else {
+            int found = 0;
+            if (node->is_terminal) {
+                prefix[path_len] = '\0';
+                radix_key_flip(tree->key_mode, prefix, path_len);
+                callback(prefix, node->value);
+                radix_key_flip(tree->key_mode, prefix, path_len);
+                found++;
+            }
+            return found + radix_traverse_recursive(node->children['.'], prefix, path_len, tree->key_mode, callback);
+        }
+    }
+    return radix_traverse_recursive(node, prefix, path_len - node->key_len, tree->key_mode, callback);
+}
+
+// Walk the stored keys that are suffixes of key, shortest first, reporting
+// them to callback if it is not NULL. The longest one's length and value
+// are left in *longest_len and *longest_value. Returns how many there are.
+static int radix_suffix_walk(RadixTree *tree, const char *key, void (*callback)(const char*, void*),
+                             int *longest_len, void **longest_value) {
+    int key_len = strlen(key);
+    int found = 0;
+    *longest_len = -1;
+    *longest_value = NULL;
+    
+    // Forward trees look up each suffix of key on its own
+    if (tree->key_mode == RADIX_KEYS_FORWARD) {
+        char path[MAX_KEY_LENGTH];
+        for (int start = key_len; start >= 0; start--) {
+            int path_len = 0;
+            RadixNode *node = radix_find_prefix_node(tree->root, key + start, path, &path_len);
+            if (!node || !node->is_terminal || path_len != key_len - start) continue;
+            
+            if (callback) {
+                callback(key + start, node->value);
+            }
+            *longest_len = key_len - start;
+            *longest_value = node->value;
+            found++;
+        }
+        return found;
+    }
+    
+    // Otherwise they are the terminals on the path spelled by the stored key
+    char stored[MAX_KEY_LENGTH];
+    char match[MAX_KEY_LENGTH];
+    key = radix_key_encode(tree, key, stored);
+    if (!key) return 0;
+    
+    int depth = 0;
+    RadixNode *node = tree->root;
+    while (node) {
+        int node_key_len = node->key_len;
+        if (depth + node_key_len > key_len || memcmp(node->key, key + depth, node_key_len) != 0) break;
+        depth += node_key_len;
+        
+        // Label trees only take suffixes made of whole labels
+        bool whole = tree->key_mode != RADIX_KEYS_LABELS || depth == 0 || depth == key_len ||
+                     key[depth] == '.' || key[depth - 1] == '.';
+        if (node->is_terminal && whole) {
+            if (callback) {
+                memcpy(match, key, depth);
+                match[depth] = '\0';
+                radix_key_flip(tree->key_mode, match, depth);
+                callback(match, node->value);
+            }
+            *longest_len = depth;
+            *longest_value = node->value;
+            found++;
+        }
+        
+        if (depth == key_len) break;
+        node = node->children[(unsigned char)key[depth]];
+    }
+    return found;
+}
+
+// Report the stored keys that are suffixes of key, shortest first, such as
+// the parent domains "example.com" and "b.example.com" of
+// "a.b.example.com". In RADIX_KEYS_LABELS trees only suffixes made of
+// whole labels count. Reversed and label trees find them all in one
+// descent; forward trees look up every suffix. Returns how many there are.
+int radix_match_suffixes(RadixTree *tree, const char *key, void (*callback)(const char*, void*)) {
+    if (!tree || !key || !callback) return 0;
+    
+    int longest_len;
+    void *longest_value;
+    return radix_suffix_walk(tree, key, callback, &longest_len, &longest_value);
+}
+
+// Find the longest stored key that is a suffix of key, by the rules of
+// radix_match_suffixes. Returns its length, or -1 if there is none, and
+// stores its value in *value if value is not NULL.
+int radix_longest_suffix(RadixTree *tree, const char *key, void **value) {
+    if (!tree || !key) return -1;
+    
+    int longest_len;
+    void *longest_value;
+    radix_suffix_walk(tree, key, NULL, &longest_len, &longest_value);
+    if (value && longest_len >= 0) {
+        *value = longest_value;
+    }
+    return longest_len;
+}
+
+// Read the CPUs of each NUMA node from sysfs. Nodes without CPUs are
+// skipped. Returns the number of nodes found, 0 if none are listed.
+static int radix_numa_nodes(cpu_set_t *node_cpus, int max_nodes) {
+    int count = 0;
+    for (int node = 0; node < 1024 && count < max_nodes; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(path, "r");
+        if (!file) continue;
+        
+        // A list of ranges such as "0-3,8-11"
+        char list[4096];
+        bool read = fgets(list, sizeof(list), file) != NULL;
+        fclose(file);
+        if (!read) continue;
+        
+        CPU_ZERO(&node_cpus[count]);
+        char *cursor = list;
+        while (*cursor >= '0' && *cursor <= '9') {
+            long first = strtol(cursor, &cursor, 10);
+            long last = first;
+            if (*cursor == '-') {
+                last = strtol(cursor + 1, &cursor, 10);
+            }
+            for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+                CPU_SET(cpu, &node_cpus[count]);
+            }
+            if (*cursor == ',') cursor++;
+        }
+        if (CPU_COUNT(&node_cpus[count]) > 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Oldest log position some replica has not applied yet
+static uint64_t radix_replicated_min_applied(RadixReplicated *set) {
+    uint64_t min = set->tail;
+    for (int r = 0; r < set->num_replicas; r++) {
+        if (set->replicas[r].applied < min) {
+            min = set->replicas[r].applied;
+        }
+    }
+    return min;
+}
+
+// Wait until no search announced in the given version is still running
+static void radix_replica_drain(RadixReplica *replica, int version) {
+    int num_readers = CPU_COUNT(&replica->cpus) > 0 ? CPU_COUNT(&replica->cpus) : 1;
+    for (int i = 0; i < num_readers; i++) {
+        while (__atomic_load_n(&replica->readers[i].count[version], __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    }
+}
+
+// Apply log entries [start, end) to one copy of a replica
+static void radix_replica_apply(RadixReplicated *set, RadixTree *tree, uint64_t start, uint64_t end) {
+    for (uint64_t i = start; i < end; i++) {
+        RadixLogEntry *entry = &set->log[i % RADIX_LOG_CAPACITY];
+        if (entry->is_delete) {
+            radix_delete(tree, entry->key);
+        } else {
+            radix_insert(tree, entry->key, entry->value);
+        }
+    }
+}
+
+// Thread owning one replica. It runs on the replica's node and creates and
+// grows the trees itself, so the default first-touch policy places the
+// replica's memory on that node. Each batch goes into the copy searches are
+// not reading, which is then published; searches never wait for it.
+static void* radix_replica_applier(void *arg) {
+    RadixReplica *replica = (RadixReplica*)arg;
+    RadixReplicated *set = replica->set;
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &replica->cpus);
+    
+    int num_readers = CPU_COUNT(&replica->cpus) > 0 ? CPU_COUNT(&replica->cpus) : 1;
+    RadixTree *trees[2] = { radix_create(), radix_create() };
+    void *readers = NULL;
+    if (!trees[0] || !trees[1] || posix_memalign(&readers, 64, num_readers * sizeof(RadixReaderSlot)) != 0) {
+        radix_free(trees[0]);
+        radix_free(trees[1]);
+        trees[0] = trees[1] = NULL;
+        readers = NULL;
+    } else {
+        memset(readers, 0, num_readers * sizeof(RadixReaderSlot));
+    }
+    
+    pthread_mutex_lock(&set->lock);
+    replica->trees[0] = trees[0];
+    replica->trees[1] = trees[1];
+    replica->readers = (RadixReaderSlot*)readers;
+    replica->started = true;
+    pthread_cond_broadcast(&set->progress);
+    
+    while (readers) {
+        while (replica->applied == set->tail && !set->stopping) {
+            pthread_cond_wait(&set->appended, &set->lock);
+        }
+        
+        // Stop only once the log is drained
+        if (replica->applied == set->tail) break;
+        
+        uint64_t start = replica->applied;
+        uint64_t end = set->tail;
+        if (end - start > RADIX_LOG_BATCH) {
+            end = start + RADIX_LOG_BATCH;
+        }
+        pthread_mutex_unlock(&set->lock);
+        
+        // Writers leave these entries alone until every replica is past them
+        int active = replica->active;
+        radix_replica_apply(set, trees[!active], start, end);
+        __atomic_store_n(&replica->active, !active, __ATOMIC_SEQ_CST);
+        
+        // Searches that may still be in the old copy announced themselves in
+        // the current version; move new ones to the other and wait both out
+        int version = replica->version;
+        radix_replica_drain(replica, !version);
+        __atomic_store_n(&replica->version, !version, __ATOMIC_SEQ_CST);
+        radix_replica_drain(replica, version);
+        radix_replica_apply(set, trees[active], start, end);
+        
+        pthread_mutex_lock(&set->lock);
+        replica->applied = end;
+        pthread_cond_broadcast(&set->progress);
+    }
+    pthread_mutex_unlock(&set->lock);
+    return NULL;
+}
+
+// Create a replicated tree with one replica per given CPU set
+static RadixReplicated* radix_replicated_create_on(RadixReplicaPolicy policy, int max_lag,
+                                                   const cpu_set_t *node_cpus, int num_nodes) {
+    RadixReplicated *set = (RadixReplicated*)calloc(1, sizeof(RadixReplicated));
+    if (!set) return NULL;
+    set->replicas = (RadixReplica*)calloc(num_nodes, sizeof(RadixReplica));
+    if (!set->replicas) {
+        free(set);
+        return NULL;
+    }
+    
+    set->policy = policy;
+    set->max_lag = policy == RADIX_REPLICA_SYNC || max_lag < 0 ? 0 : (uint64_t)max_lag;
+    if (set->max_lag >= RADIX_LOG_CAPACITY) {
+        set->max_lag = RADIX_LOG_CAPACITY - 1;
+    }
+    pthread_mutex_init(&set->lock, NULL);
+    pthread_cond_init(&set->appended, NULL);
+    pthread_cond_init(&set->progress, NULL);
+    
+    for (int r = 0; r < num_nodes; r++) {
+        RadixReplica *replica = &set->replicas[r];
+        replica->cpus = node_cpus[r];
+        replica->set = set;
+        int slot = 0;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &node_cpus[r])) {
+                set->cpu_replica[cpu] = r;
+                set->cpu_slot[cpu] = slot++;
+            }
+        }
+        if (pthread_create(&replica->applier, NULL, radix_replica_applier, replica) != 0) break;
+        set->num_replicas++;
+    }
+    
+    // Wait for the appliers to create their trees
+    bool failed = set->num_replicas < num_nodes;
+    pthread_mutex_lock(&set->lock);
+    for (int r = 0; r < set->num_replicas; r++) {
+        while (!set->replicas[r].started) {
+            pthread_cond_wait(&set->progress, &set->lock);
+        }
+        if (!set->replicas[r].readers) {
+            failed = true;
         }
     }
+    pthread_mutex_unlock(&set->lock);
+    
+    if (failed) {
+        radix_replicated_free(set);
+        return NULL;
+    }
+    return set;
+}
+
+// Create a tree replicated on every NUMA node, for read-mostly data
+// searched from several sockets. Each replica lives in memory local to its
+// node and serves the threads running there, so a search never crosses the
+// interconnect. Writes are logged and replayed on every replica; policy
+// says whether a write waits for all replicas (RADIX_REPLICA_SYNC) or only
+// until none trails by more than max_lag writes (RADIX_REPLICA_BOUNDED).
+// Systems that list no NUMA nodes get a single replica.
+RadixReplicated* radix_replicated_create(RadixReplicaPolicy policy, int max_lag) {
+    cpu_set_t *node_cpus = (cpu_set_t*)malloc(RADIX_MAX_REPLICAS * sizeof(cpu_set_t));
+    if (!node_cpus) return NULL;
+    
+    int num_nodes = radix_numa_nodes(node_cpus, RADIX_MAX_REPLICAS);
+    if (num_nodes == 0) {
+        CPU_ZERO(&node_cpus[0]);
+        sched_getaffinity(0, sizeof(cpu_set_t), &node_cpus[0]);
+        num_nodes = 1;
+    }
+    
+    RadixReplicated *set = radix_replicated_create_on(policy, max_lag, node_cpus, num_nodes);
+    free(node_cpus);
+    return set;
+}
+
+// Stop the appliers once they have replayed the whole log and free everything
+void radix_replicated_free(RadixReplicated *set) {
+    if (!set) return;
+    
+    pthread_mutex_lock(&set->lock);
+    set->stopping = true;
+    pthread_cond_broadcast(&set->appended);
+    pthread_mutex_unlock(&set->lock);
+    
+    for (int r = 0; r < set->num_replicas; r++) {
+        pthread_join(set->replicas[r].applier, NULL);
+        radix_free(set->replicas[r].trees[0]);
+        radix_free(set->replicas[r].trees[1]);
+        free(set->replicas[r].readers);
+    }
+    for (int i = 0; i < RADIX_LOG_CAPACITY; i++) {
+        free(set->log[i].key);
+    }
+    pthread_mutex_destroy(&set->lock);
+    pthread_cond_destroy(&set->appended);
+    pthread_cond_destroy(&set->progress);
+    free(set->replicas);
+    free(set);
+}
+
+// Append an update to the log and wait as the policy says
+static int radix_replicated_write(RadixReplicated *set, const char *key, void *value, bool is_delete) {
+    if (!set || !key) return 0;
+    
+    char *copy = strdup(key);
+    if (!copy) return 0;
+    
+    pthread_mutex_lock(&set->lock);
+    
+    // The slot to reuse must have been applied everywhere
+    while (radix_replicated_min_applied(set) + RADIX_LOG_CAPACITY <= set->tail) {
+        pthread_cond_wait(&set->progress, &set->lock);
+    }
+    RadixLogEntry *entry = &set->log[set->tail % RADIX_LOG_CAPACITY];
+    free(entry->key);
+    entry->key = copy;
+    entry->value = value;
+    entry->is_delete = is_delete;
+    set->tail++;
+    pthread_cond_broadcast(&set->appended);
+    
+    while (radix_replicated_min_applied(set) + set->max_lag < set->tail) {
+        pthread_cond_wait(&set->progress, &set->lock);
+    }
+    pthread_mutex_unlock(&set->lock);
+    return 1;
+}
+
+// Insert into every replica. Returns 1 once the write is logged and the
+// policy is met; whether the key is new is not known at that point.
+int radix_replicated_insert(RadixReplicated *set, const char *key, void *value) {
+    return radix_replicated_write(set, key, value, false);
+}
+
+// Delete from every replica, with the same return as radix_replicated_insert
+int radix_replicated_delete(RadixReplicated *set, const char *key) {
+    return radix_replicated_write(set, key, NULL, true);
+}
+
+// Search the replica of the NUMA node the calling thread runs on, without
+// locking or waiting for its applier. Under RADIX_REPLICA_BOUNDED it may
+// miss up to max_lag of the latest writes.
+void* radix_replicated_search(RadixReplicated *set, const char *key) {
+    if (!set || !key) return NULL;
+    
+    int cpu = sched_getcpu();
+    bool known = cpu >= 0 && cpu < CPU_SETSIZE;
+    RadixReplica *replica = &set->replicas[known ? set->cpu_replica[cpu] : 0];
+    uint64_t *count = replica->readers[known ? set->cpu_slot[cpu] : 0].count;
+    
+    // Announce the search, so the applier leaves the copy it reads alone
+    int version = __atomic_load_n(&replica->version, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&count[version], 1, __ATOMIC_SEQ_CST);
+    RadixTree *tree = replica->trees[__atomic_load_n(&replica->active, __ATOMIC_SEQ_CST)];
+    void *value = radix_search(tree, key);
+    __atomic_fetch_sub(&count[version], 1, __ATOMIC_RELEASE);
+    return value;
+}
+
+// Wait until every replica has applied every write made so far
+void radix_replicated_sync(RadixReplicated *set) {
+    if (!set) return;
+    
+    pthread_mutex_lock(&set->lock);
+    while (radix_replicated_min_applied(set) < set->tail) {
+        pthread_cond_wait(&set->progress, &set->lock);
+    }
+    pthread_mutex_unlock(&set->lock);
 }
 
 // Example callback function for traversal
@@ -416,9 +3628,21 @@ void print_key_value(const char *key, void *value) {
     printf("Key: '%s', Value: %p\n", key, value);
 }
 
+// Example callback function for fuzzy search
+void print_key_distance(const char *key, void *value, int distance) {
+    printf("Key: '%s', Value: %p, Distance: %d\n", key, value, distance);
+}
+
+// Example score function: values are ints, bigger is better
+double int_score(void *value) {
+    return *(int*)value;
+}
+
 // Example usage and test function
 int main() {
     RadixTree *tree = radix_create();
+    radix_set_lazy_verify(tree, true);
+    radix_set_track_counts(tree, true);
     
     // Test data
     char *keys[] = {"hello", "help", "hell", "world", "word", "work", "test", "testing", "tea", "team"};
@@ -452,6 +3676,13 @@ int main() {
     
     // Search for non-existent key
     printf("Search 'nonexistent': %s\n", radix_search(tree, "nonexistent") ? "FOUND" : "NOT FOUND");
+    
+#if __cplusplus >= 202002L
+    // The same lookups interleaved on one thread
+    void *found_values[sizeof(keys) / sizeof(keys[0])];
+    int found = radix_search_interleaved(tree, (const char**)keys, num_keys, found_values, 4);
+    printf("Interleaved search: %d of %d found\n", found, num_keys);
+#endif
     printf("\n");
     
     // Traverse tree
@@ -459,6 +3690,24 @@ int main() {
     radix_traverse(tree, print_key_value);
     printf("\n");
     
+    // Counting and paging in key order
+    char nth_key[MAX_KEY_LENGTH];
+    radix_select(tree, 3, nth_key, NULL);
+    printf("Keys starting with 'wor': %d\n", radix_count_prefix(tree, "wor"));
+    printf("Key at position 3: '%s', keys before 'tes': %d\n", nth_key, radix_rank(tree, "tes"));
+    printf("\n");
+    
+    // Typo-tolerant search
+    printf("Keys within distance 1 of 'wark':\n");
+    radix_fuzzy_search(tree, "wark", 1, print_key_distance);
+    printf("\n");
+    
+    // Glob pattern query
+    printf("Keys matching 'w?r*' or '*[lp]':\n");
+    radix_match_pattern(tree, "w?r*", print_key_value);
+    radix_match_pattern(tree, "*[lp]", print_key_value);
+    printf("\n");
+    
     // Delete some keys
     printf("Deleting keys:\n");
     char *keys_to_delete[] = {"help", "test", "word"};
@@ -479,8 +3728,107 @@ int main() {
     printf("Final tree traversal:\n");
     radix_traverse(tree, print_key_value);
     
+    // Pack the remaining nodes into one block
+    RadixMemoryStats before, after;
+    radix_compact(tree, &before, &after);
+    printf("\nCompacted %d nodes: %d allocations -> %d, %zu bytes -> %zu bytes\n",
+           after.nodes, before.allocations, after.allocations, before.total_bytes, after.total_bytes);
+    
     // Cleanup
     radix_free(tree);
     
+    // Top-K completions by score
+    printf("\nTop 3 completions of 'te' by score:\n");
+    RadixTree *scored = radix_create_scored(int_score);
+    void *value_ptrs[sizeof(keys) / sizeof(keys[0])];
+    for (int i = 0; i < num_keys; i++) {
+        value_ptrs[i] = &values[i];
+    }
+    radix_insert_batch(scored, (const char**)keys, value_ptrs, num_keys, false);
+    radix_topk(scored, "te", 3, print_key_value);
+    
+    // Set operations: keep the scored keys that are not in a second tree
+    printf("\nScored keys not starting with 'te':\n");
+    RadixTree *other = radix_create();
+    radix_insert_batch(other, (const char**)keys + 6, value_ptrs + 6, num_keys - 6, false);
+    radix_difference(scored, other, 2);
+    radix_traverse(scored, print_key_value);
+    radix_free(other);
+    radix_free(scored);
+    
+    // Dictionary-style data: few distinct values, shared key endings
+    const char *pages[] = {"blog/index.html", "docs/index.html", "shop/index.html", "blog/about.html", "docs/about.html"};
+    int num_pages = sizeof(pages) / sizeof(pages[0]);
+    RadixTree *site = radix_create_interned(sizeof(int));
+    for (int i = 0; i < num_pages; i++) {
+        int visible = strstr(pages[i], "index") != NULL;
+        radix_insert(site, pages[i], &visible);
+    }
+    RadixMemoryStats thawed;
+    radix_memory_usage(site, &thawed);
+    int shared = radix_freeze(site);
+    printf("\nFrozen %d pages with %u distinct values: %d nodes -> %d\n",
+           site->size, site->values->count, thawed.nodes, shared);
+    radix_traverse(site, print_key_value);
+    radix_free(site);
+    
+    // Domains stored label-reversed, so parents and subdomains are prefix walks
+    const char *domains[] = {"example.com", "mail.example.com", "a.b.example.com", "example.org", "myexample.com"};
+    int num_domains = sizeof(domains) / sizeof(domains[0]);
+    RadixTree *zones = radix_create();
+    radix_set_key_mode(zones, RADIX_KEYS_LABELS);
+    for (int i = 0; i < num_domains; i++) {
+        radix_insert(zones, domains[i], &values[i]);
+    }
+    printf("\nDomains under 'example.com':\n");
+    radix_scan_suffix(zones, "example.com", print_key_value);
+    printf("Stored parents of 'x.a.b.example.com':\n");
+    radix_match_suffixes(zones, "x.a.b.example.com", print_key_value);
+    radix_free(zones);
+    
+    // A cache with room for a few nodes, where the keys looked up stay
+    RadixTree *cache = radix_create();
+    radix_set_budget(cache, 6 * sizeof(RadixNode), NULL);
+    for (int i = 0; i < num_keys; i++) {
+        radix_insert(cache, keys[i], &values[i]);
+        radix_search(cache, "hello");
+        radix_search(cache, "help");
+    }
+    printf("\nCache kept %d of %d keys in %zu bytes:\n", cache->size, num_keys, radix_used_bytes(cache));
+    radix_traverse(cache, print_key_value);
+    radix_free(cache);
+    
+    // A replicated tree, with one copy per NUMA node
+    RadixReplicated *replicated = radix_replicated_create(RADIX_REPLICA_SYNC, 0);
+    for (int i = 0; i < num_keys; i++) {
+        radix_replicated_insert(replicated, keys[i], &values[i]);
+    }
+    radix_replicated_delete(replicated, "team");
+    printf("\nReplicated on %d node(s): 'tea' %s, 'team' %s\n", replicated->num_replicas,
+           radix_replicated_search(replicated, "tea") ? "FOUND" : "NOT FOUND",
+           radix_replicated_search(replicated, "team") ? "FOUND" : "NOT FOUND");
+    radix_replicated_free(replicated);
+    
+    // A follower kept current from the leader's change feed
+    RadixTree *leader = radix_create();
+    RadixTree *follower = radix_create();
+    radix_set_change_feed(leader, 64);
+    uint64_t position = radix_change_seq(leader);
+    for (int i = 0; i < num_keys; i++) {
+        radix_insert(leader, keys[i], &values[i]);
+    }
+    radix_delete(leader, "hell");
+    radix_delete(leader, "work");
+    char *changes;
+    size_t changes_size;
+    int num_changes = radix_export_changes(leader, position, 0, &changes, &changes_size);
+    radix_apply_changes(follower, changes, changes_size, &position);
+    free(changes);
+    printf("\nFollower after %d changes in %zu bytes (at sequence %llu):\n",
+           num_changes, changes_size, (unsigned long long)position);
+    radix_traverse(follower, print_key_value);
+    radix_free(leader);
+    radix_free(follower);
+    
     return 0;
 }
\ No newline at end of file
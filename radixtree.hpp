@@ -0,0 +1,617 @@
+// Header-only generic radix tree.
+//
+// Same split and merge algorithms as radixtree.cpp, but keys and values are
+// typed: values are stored inside the node when they are small (and may be
+// move-only), keys are any byte sequence described by a KeyCodec, and the
+// alphabet (how many bits of the key select a child, hence the fan-out of a
+// node) is fixed at compile time by the tree's Traits.
+#ifndef RADIXTREE_HPP
+#define RADIXTREE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace radix {
+
+// Alphabet cutting every key byte into 8 / Bits symbols of Bits bits each,
+// most significant first. A node has one child slot per symbol value.
+template <unsigned Bits>
+struct BitsAlphabet {
+    static_assert(Bits == 1 || Bits == 2 || Bits == 4 || Bits == 8, "symbols must evenly divide a byte");
+
+    static constexpr size_t fanout = size_t(1) << Bits;
+    static constexpr size_t symbols_per_byte = 8 / Bits;
+
+    static unsigned symbol(const uint8_t *bytes, size_t i) {
+        unsigned shift = 8 - Bits * (unsigned)(i % symbols_per_byte + 1);
+        return (bytes[i / symbols_per_byte] >> shift) & (fanout - 1);
+    }
+
+    // Write symbols back into bytes, the inverse of symbol()
+    static void pack(const uint8_t *symbols, size_t count, uint8_t *bytes) {
+        for (size_t i = 0; i < count; i += symbols_per_byte) {
+            uint8_t byte = 0;
+            for (size_t j = 0; j < symbols_per_byte; j++) {
+                byte = (uint8_t)((byte << Bits) | symbols[i + j]);
+            }
+            bytes[i / symbols_per_byte] = byte;
+        }
+    }
+};
+
+using ByteAlphabet = BitsAlphabet<8>;    // 256-way nodes, like radixtree.cpp
+using NibbleAlphabet = BitsAlphabet<4>;  // 16-way nodes
+using BitAlphabet = BitsAlphabet<1>;     // Binary (PATRICIA-style) nodes
+
+// How a key type is viewed as bytes and rebuilt from them
+template <class Key>
+struct KeyCodec;
+
+template <>
+struct KeyCodec<std::string> {
+    static const uint8_t* data(const std::string &key) { return (const uint8_t*)key.data(); }
+    static size_t size(const std::string &key) { return key.size(); }
+    static std::string make(const uint8_t *bytes, size_t size) { return std::string((const char*)bytes, size); }
+};
+
+template <>
+struct KeyCodec<std::vector<uint8_t>> {
+    static const uint8_t* data(const std::vector<uint8_t> &key) { return key.data(); }
+    static size_t size(const std::vector<uint8_t> &key) { return key.size(); }
+    static std::vector<uint8_t> make(const uint8_t *bytes, size_t size) { return std::vector<uint8_t>(bytes, bytes + size); }
+};
+
+// Key of exactly N bytes, such as an encoded integer or a tuple of them.
+// Build one with make_key() so that byte order matches value order.
+template <size_t N>
+struct FixedKey {
+    std::array<uint8_t, N> bytes;
+
+    bool operator==(const FixedKey &other) const { return bytes == other.bytes; }
+    bool operator<(const FixedKey &other) const { return bytes < other.bytes; }
+};
+
+template <size_t N>
+struct KeyCodec<FixedKey<N>> {
+    static const uint8_t* data(const FixedKey<N> &key) { return key.bytes.data(); }
+    static constexpr size_t size(const FixedKey<N>&) { return N; }
+    static FixedKey<N> make(const uint8_t *bytes, size_t) {
+        FixedKey<N> key;
+        memcpy(key.bytes.data(), bytes, N);
+        return key;
+    }
+};
+
+// Order-preserving big-endian encoding of one key field. Signed integers
+// get their sign bit flipped, and floats are mapped so that negative
+// values sort below positive ones (NaNs sort at the ends).
+template <class T>
+void encode_field(T value, uint8_t *out) {
+    static_assert(std::is_arithmetic<T>::value, "key fields must be integers or floats");
+
+    using Bits = typename std::conditional<sizeof(T) == 1, uint8_t,
+                 typename std::conditional<sizeof(T) == 2, uint16_t,
+                 typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type>::type>::type;
+    constexpr Bits sign = Bits(1) << (sizeof(T) * 8 - 1);
+
+    Bits bits;
+    memcpy(&bits, &value, sizeof(T));
+    if constexpr (std::is_floating_point<T>::value) {
+        bits = (bits & sign) ? Bits(~bits) : Bits(bits | sign);
+    } else if constexpr (std::is_signed<T>::value) {
+        bits ^= sign;
+    }
+
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out[i] = (uint8_t)(bits >> (8 * (sizeof(T) - 1 - i)));
+    }
+}
+
+// Inverse of encode_field()
+template <class T>
+T decode_field(const uint8_t *in) {
+    using Bits = typename std::conditional<sizeof(T) == 1, uint8_t,
+                 typename std::conditional<sizeof(T) == 2, uint16_t,
+                 typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type>::type>::type;
+    constexpr Bits sign = Bits(1) << (sizeof(T) * 8 - 1);
+
+    Bits bits = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        bits = (Bits)((bits << 8) | in[i]);
+    }
+    if constexpr (std::is_floating_point<T>::value) {
+        bits = (bits & sign) ? Bits(bits & ~sign) : Bits(~bits);
+    } else if constexpr (std::is_signed<T>::value) {
+        bits ^= sign;
+    }
+
+    T value;
+    memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+// Build a composite key from its fields, most significant first:
+// make_key(int32_t(tenant), uint64_t(timestamp)) is a FixedKey<12>
+template <class... Fields>
+FixedKey<(sizeof(Fields) + ... + 0)> make_key(Fields... fields) {
+    FixedKey<(sizeof(Fields) + ... + 0)> key;
+    size_t offset = 0;
+    ((encode_field(fields, key.bytes.data() + offset), offset += sizeof(Fields)), ...);
+    return key;
+}
+
+// Read back the field of type T stored at byte offset of a composite key
+template <class T, size_t N>
+T key_field(const FixedKey<N> &key, size_t offset = 0) {
+    return decode_field<T>(key.bytes.data() + offset);
+}
+
+// Default compile-time configuration of a tree. Derive from it and
+// override members to change the alphabet or the inline value limit.
+template <class Key>
+struct DefaultTraits {
+    using Alphabet = ByteAlphabet;
+    using Codec = KeyCodec<Key>;
+
+    // Values up to this size live inside the node, bigger ones get their own allocation
+    static constexpr size_t inline_value_size = 2 * sizeof(void*);
+
+    // Length in bytes shared by every key, 0 when keys vary in length
+    static constexpr size_t key_length = 0;
+};
+
+// Configuration for FixedKey<N>. Since no key can be a prefix of another,
+// keys only end at leaves and lookups skip all key length checks.
+template <size_t N>
+struct FixedKeyTraits : DefaultTraits<FixedKey<N>> {
+    static constexpr size_t key_length = N;
+};
+
+template <class Key, class Value, class Traits = DefaultTraits<Key>, class Alloc = std::allocator<Value>>
+class RadixTree {
+    using Alphabet = typename Traits::Alphabet;
+    using Codec = typename Traits::Codec;
+    using AllocTraits = std::allocator_traits<Alloc>;
+
+    static constexpr size_t fanout = Alphabet::fanout;
+    static constexpr size_t key_symbols = Traits::key_length * Alphabet::symbols_per_byte;
+    static constexpr bool inline_value = sizeof(Value) <= Traits::inline_value_size;
+
+    using SymbolAlloc = typename AllocTraits::template rebind_alloc<uint8_t>;
+    using Segment = std::vector<uint8_t, SymbolAlloc>;
+
+    struct InlineBuffer {
+        alignas(Value) unsigned char bytes[sizeof(Value)];
+    };
+
+    // Storage for the value of a terminal node, constructed only while the node is terminal
+    struct ValueSlot {
+        typename std::conditional<inline_value, InlineBuffer, Value*>::type storage;
+
+        Value& get() {
+            if constexpr (inline_value) {
+                return *std::launder(reinterpret_cast<Value*>(&storage));
+            } else {
+                return *storage;
+            }
+        }
+
+        template <class... Args>
+        void emplace(Alloc &alloc, Args&&... args) {
+            if constexpr (inline_value) {
+                ::new ((void*)&storage) Value(std::forward<Args>(args)...);
+            } else {
+                storage = AllocTraits::allocate(alloc, 1);
+                AllocTraits::construct(alloc, storage, std::forward<Args>(args)...);
+            }
+        }
+
+        void destroy(Alloc &alloc) {
+            if constexpr (inline_value) {
+                get().~Value();
+            } else {
+                AllocTraits::destroy(alloc, storage);
+                AllocTraits::deallocate(alloc, storage, 1);
+            }
+        }
+    };
+
+    struct Node {
+        Segment key;                        // Compressed key segment, one symbol per element
+        std::array<Node*, fanout> children; // Children indexed by their first symbol
+        int num_children;                   // Number of active children
+        bool is_terminal;                   // True if a key ends here and value is constructed
+        ValueSlot value;
+
+        explicit Node(const SymbolAlloc &alloc) : key(alloc), num_children(0), is_terminal(false) {
+            children.fill(nullptr);
+        }
+    };
+
+    using NodeAlloc = typename AllocTraits::template rebind_alloc<Node>;
+    using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using allocator_type = Alloc;
+
+    explicit RadixTree(const Alloc &alloc = Alloc())
+        : value_alloc_(alloc), node_alloc_(alloc), root_(nullptr), size_(0) {
+        root_ = create_node(nullptr, 0, 0);
+    }
+
+    RadixTree(const RadixTree&) = delete;
+    RadixTree& operator=(const RadixTree&) = delete;
+
+    RadixTree(RadixTree &&other) noexcept
+        : value_alloc_(std::move(other.value_alloc_)), node_alloc_(std::move(other.node_alloc_)),
+          root_(other.root_), size_(other.size_) {
+        other.root_ = nullptr;
+        other.size_ = 0;
+    }
+
+    RadixTree& operator=(RadixTree &&other) noexcept {
+        if (this != &other) {
+            free_subtree(root_);
+            value_alloc_ = std::move(other.value_alloc_);
+            node_alloc_ = std::move(other.node_alloc_);
+            root_ = other.root_;
+            size_ = other.size_;
+            other.root_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    ~RadixTree() {
+        free_subtree(root_);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Insert a key or replace its value. Returns true if the key is new.
+    template <class... Args>
+    bool insert(const Key &key, Args&&... args) {
+        KeyView view = view_of(key);
+        bool inserted = false;
+        root_ = insert_recursive(root_, view, 0, inserted, std::forward<Args>(args)...);
+        if (inserted) {
+            size_++;
+        }
+        return inserted;
+    }
+
+    // Find the value of a key, nullptr if absent
+    Value* find(const Key &key) {
+        KeyView view = view_of(key);
+        Node *node = root_;
+        size_t pos = 0;
+
+        while (node) {
+            size_t common = common_prefix(node, view, pos);
+            if (common != node->key.size()) return nullptr;
+            pos += common;
+            if (pos == view.length) {
+                // With fixed-length keys only leaves are reached here, and they are all terminal
+                return (key_symbols || node->is_terminal) ? &node->value.get() : nullptr;
+            }
+            node = node->children[view.symbol(pos)];
+        }
+        return nullptr;
+    }
+
+    const Value* find(const Key &key) const {
+        return const_cast<RadixTree*>(this)->find(key);
+    }
+
+    bool contains(const Key &key) const { return find(key) != nullptr; }
+
+    // Remove a key. Returns true if it was present.
+    bool erase(const Key &key) {
+        KeyView view = view_of(key);
+        bool deleted = false;
+        root_ = erase_recursive(root_, view, 0, deleted);
+        if (deleted) {
+            size_--;
+        }
+        return deleted;
+    }
+
+    void clear() {
+        free_subtree(root_);
+        root_ = create_node(nullptr, 0, 0);
+        size_ = 0;
+    }
+
+    // Call fn(key, value) for every key in order
+    template <class Fn>
+    void for_each(Fn &&fn) {
+        if (!root_) return;  // Moved from
+        std::vector<uint8_t> symbols;
+        traverse(root_, symbols, fn);
+    }
+
+    // Call fn(key, value) in order for every key with lo <= key <= hi.
+    // Only the subtrees overlapping the range are visited.
+    template <class Fn>
+    void scan_range(const Key &lo, const Key &hi, Fn &&fn) {
+        if (!root_) return;  // Moved from
+        std::vector<uint8_t> symbols;
+        KeyView lo_view = view_of(lo);
+        KeyView hi_view = view_of(hi);
+        scan_range_recursive(root_, symbols, lo_view, hi_view, true, true, fn);
+    }
+
+private:
+    // A key seen as a sequence of alphabet symbols
+    struct KeyView {
+        const uint8_t *bytes;
+        size_t length;  // In symbols
+
+        unsigned symbol(size_t i) const { return Alphabet::symbol(bytes, i); }
+    };
+
+    static KeyView view_of(const Key &key) {
+        if constexpr (key_symbols != 0) {
+            return KeyView{Codec::data(key), key_symbols};
+        } else {
+            return KeyView{Codec::data(key), Codec::size(key) * Alphabet::symbols_per_byte};
+        }
+    }
+
+    // Length of the common prefix of a node's segment and the key from pos
+    static size_t common_prefix(const Node *node, const KeyView &view, size_t pos) {
+        size_t limit = node->key.size();
+        if constexpr (key_symbols == 0) {
+            // A fixed-length key always reaches at least as deep as the path it follows
+            if (view.length - pos < limit) limit = view.length - pos;
+        }
+
+        size_t i = 0;
+        while (i < limit && node->key[i] == view.symbol(pos + i)) {
+            i++;
+        }
+        return i;
+    }
+
+    // Create a node whose segment is the key's symbols [from, to)
+    Node* create_node(const KeyView *view, size_t from, size_t to) {
+        Node *node = NodeAllocTraits::allocate(node_alloc_, 1);
+        NodeAllocTraits::construct(node_alloc_, node, SymbolAlloc(value_alloc_));
+        node->key.reserve(to - from);
+        for (size_t i = from; i < to; i++) {
+            node->key.push_back((uint8_t)view->symbol(i));
+        }
+        return node;
+    }
+
+    void destroy_node(Node *node) {
+        if (node->is_terminal) {
+            node->value.destroy(value_alloc_);
+        }
+        NodeAllocTraits::destroy(node_alloc_, node);
+        NodeAllocTraits::deallocate(node_alloc_, node, 1);
+    }
+
+    void free_subtree(Node *node) {
+        if (!node) return;
+
+        for (Node *child : node->children) {
+            free_subtree(child);
+        }
+        destroy_node(node);
+    }
+
+    template <class... Args>
+    void set_value(Node *node, bool &inserted, Args&&... args) {
+        if (node->is_terminal) {
+            node->value.destroy(value_alloc_);
+        } else {
+            node->is_terminal = true;
+            inserted = true;
+        }
+        node->value.emplace(value_alloc_, std::forward<Args>(args)...);
+    }
+
+    // Split a node after its first common symbols, moving the rest of the
+    // segment, the value and the children into a new single child
+    void split(Node *node, size_t common) {
+        Node *new_node = NodeAllocTraits::allocate(node_alloc_, 1);
+        NodeAllocTraits::construct(node_alloc_, new_node, SymbolAlloc(value_alloc_));
+
+        new_node->key.assign(node->key.begin() + common, node->key.end());
+        new_node->children = node->children;
+        new_node->num_children = node->num_children;
+        if (node->is_terminal) {
+            new_node->value.emplace(value_alloc_, std::move(node->value.get()));
+            new_node->is_terminal = true;
+            node->value.destroy(value_alloc_);
+            node->is_terminal = false;
+        }
+
+        node->key.resize(common);
+        node->children.fill(nullptr);
+        node->children[new_node->key[0]] = new_node;
+        node->num_children = 1;
+    }
+
+    // Merge a non-terminal node that has exactly one child with that child
+    void merge_child(Node *node) {
+        Node *child = nullptr;
+        for (Node *candidate : node->children) {
+            if (candidate) {
+                child = candidate;
+                break;
+            }
+        }
+
+        node->key.insert(node->key.end(), child->key.begin(), child->key.end());
+        node->children = child->children;
+        node->num_children = child->num_children;
+        if (child->is_terminal) {
+            node->value.emplace(value_alloc_, std::move(child->value.get()));
+            node->is_terminal = true;
+        }
+
+        child->children.fill(nullptr);
+        destroy_node(child);
+    }
+
+    template <class... Args>
+    Node* insert_recursive(Node *node, const KeyView &view, size_t pos, bool &inserted, Args&&... args) {
+        if (!node) {
+            node = create_node(&view, pos, view.length);
+            set_value(node, inserted, std::forward<Args>(args)...);
+            return node;
+        }
+
+        size_t common = common_prefix(node, view, pos);
+
+        if (common < node->key.size()) {
+            split(node, common);
+        }
+
+        pos += common;
+        if (pos == view.length) {
+            set_value(node, inserted, std::forward<Args>(args)...);
+            return node;
+        }
+
+        unsigned first = view.symbol(pos);
+        Node *old_child = node->children[first];
+        node->children[first] = insert_recursive(old_child, view, pos, inserted, std::forward<Args>(args)...);
+        if (!old_child) {
+            node->num_children++;
+        }
+        return node;
+    }
+
+    Node* erase_recursive(Node *node, const KeyView &view, size_t pos, bool &deleted) {
+        if (!node) return nullptr;
+
+        size_t common = common_prefix(node, view, pos);
+        if (common != node->key.size()) return node;
+        pos += common;
+
+        if (pos == view.length) {
+            if (!node->is_terminal) return node;
+
+            node->value.destroy(value_alloc_);
+            node->is_terminal = false;
+            deleted = true;
+        } else {
+            unsigned first = view.symbol(pos);
+            Node *old_child = node->children[first];
+            node->children[first] = erase_recursive(old_child, view, pos, deleted);
+            if (old_child && !node->children[first]) {
+                node->num_children--;
+            }
+        }
+
+        if (!node->is_terminal) {
+            if (node->num_children == 0) {
+                if (node == root_) {
+                    // Keep an empty root rather than one spelling a deleted key
+                    node->key.clear();
+                    return node;
+                }
+                destroy_node(node);
+                return nullptr;
+            }
+            if (node->num_children == 1) {
+                merge_child(node);
+            }
+        }
+        return node;
+    }
+
+    // Rebuild the key spelled by symbols and report it with node's value
+    template <class Fn>
+    static void emit(Node *node, const std::vector<uint8_t> &symbols, Fn &fn) {
+        std::vector<uint8_t> bytes(symbols.size() / Alphabet::symbols_per_byte);
+        Alphabet::pack(symbols.data(), symbols.size(), bytes.data());
+        fn(Codec::make(bytes.data(), bytes.size()), node->value.get());
+    }
+
+    template <class Fn>
+    void traverse(Node *node, std::vector<uint8_t> &symbols, Fn &fn) {
+        size_t old_size = symbols.size();
+        symbols.insert(symbols.end(), node->key.begin(), node->key.end());
+
+        if (node->is_terminal) {
+            emit(node, symbols, fn);
+        }
+
+        for (Node *child : node->children) {
+            if (child) {
+                traverse(child, symbols, fn);
+            }
+        }
+        symbols.resize(old_size);
+    }
+
+    // lo_tight / hi_tight tell whether the path so far still equals a
+    // prefix of lo / hi. Once it is past lo or below hi, that bound is dropped.
+    template <class Fn>
+    void scan_range_recursive(Node *node, std::vector<uint8_t> &symbols, const KeyView &lo, const KeyView &hi,
+                              bool lo_tight, bool hi_tight, Fn &fn) {
+        size_t pos = symbols.size();
+
+        for (size_t i = 0; i < node->key.size() && (lo_tight || hi_tight); i++) {
+            unsigned symbol = node->key[i];
+            if (lo_tight) {
+                if (pos + i >= lo.length || symbol > lo.symbol(pos + i)) {
+                    lo_tight = false;
+                } else if (symbol < lo.symbol(pos + i)) {
+                    return;  // Whole subtree below lo
+                }
+            }
+            if (hi_tight) {
+                if (pos + i >= hi.length || symbol > hi.symbol(pos + i)) {
+                    return;  // Whole subtree above hi
+                } else if (symbol < hi.symbol(pos + i)) {
+                    hi_tight = false;
+                }
+            }
+        }
+
+        symbols.insert(symbols.end(), node->key.begin(), node->key.end());
+        pos = symbols.size();
+
+        // A key that is a proper prefix of lo sorts before it
+        if (node->is_terminal && !(lo_tight && pos < lo.length)) {
+            emit(node, symbols, fn);
+        }
+
+        if (!(hi_tight && pos >= hi.length)) {
+            size_t first = (lo_tight && pos < lo.length) ? lo.symbol(pos) : 0;
+            size_t last = hi_tight ? hi.symbol(pos) : fanout - 1;
+
+            for (size_t c = first; c <= last; c++) {
+                if (node->children[c]) {
+                    scan_range_recursive(node->children[c], symbols, lo, hi, lo_tight, hi_tight, fn);
+                }
+            }
+        }
+        symbols.resize(pos - node->key.size());
+    }
+
+    Alloc value_alloc_;
+    NodeAlloc node_alloc_;
+    Node *root_;
+    size_t size_;
+};
+
+} // namespace radix
+
+#endif // RADIXTREE_HPP
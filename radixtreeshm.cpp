@@ -0,0 +1,830 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MAX_CHILDREN 256  // For ASCII characters
+#define MAX_KEY_LENGTH 1000  // Assume keys won't exceed 1000 characters
+#define RADIX_SHM_MAGIC 0x52414449585348ULL  // "RADIXSH"
+#define RADIX_SHM_ALIGN 16  // Allocation granularity in the segment
+#define RADIX_SHM_CLASSES 512  // Free lists, one per block size up to 8 KiB
+#define RADIX_SHM_READERS 256  // Processes (or threads) that can attach at once
+#define RADIX_SHM_MAX_WRITE (2 * MAX_KEY_LENGTH + 8)  // Nodes one update can create or unlink
+
+// Block states
+#define RADIX_SHM_FREE 0
+#define RADIX_SHM_USED 1
+#define RADIX_SHM_RETIRED 2
+
+// A radix tree kept in one shared memory segment and used by several
+// processes at once. Everything in the segment refers to everything else
+// by offset from the segment start, since each process maps it at its own
+// address.
+//
+// Readers take no lock. Writers take a robust process-shared mutex and
+// never modify a node that is reachable: they copy the path down to the
+// change, then publish the new root with one atomic store. Replaced nodes
+// are retired and only reused once every reader that could still see them
+// has left, which readers announce through per-process epoch slots.
+//
+// If a writer dies holding the mutex, the next writer gets EOWNERDEAD. The
+// published tree is intact, because it was never modified in place, so
+// recovery only rebuilds the allocator: it waits for the current readers,
+// marks the nodes reachable from the root and frees every other block.
+// Readers that die are noticed by their pid and dropped from their slot.
+
+// Header in front of every allocation
+typedef struct {
+    uint32_t size;                       // Bytes including this header
+    uint32_t state;                      // RADIX_SHM_FREE, RADIX_SHM_USED or RADIX_SHM_RETIRED
+    uint64_t next;                       // Next block in a free list or in the retired list
+    uint64_t epoch;                      // Epoch a retired block was unlinked in
+    uint64_t mark;                       // Epoch of the last recovery that found the block reachable
+} RadixShmBlock;
+
+typedef struct {
+    uint64_t value;                      // Value stored at this node (0 if not a terminal)
+    uint64_t children[MAX_CHILDREN];     // Offsets of the children, 0 if none
+    uint32_t key_len;                    // Length of the key segment, which follows the node
+    uint16_t num_children;               // Number of active children
+    bool is_terminal;                    // True if this node represents end of a key
+} RadixShmNode;
+
+// Epoch slot of one attached handle
+typedef struct {
+    int32_t pid;                         // Owner, 0 if the slot is free
+    uint64_t epoch;                      // Global epoch when the current read began, 0 when not reading
+} RadixShmReader;
+
+// Start of the segment
+typedef struct {
+    uint64_t magic;                      // Set last, once the segment is ready
+    uint64_t segment_size;
+    uint64_t heap_start;                 // Offset of the first block
+    uint64_t brk;                        // End of the blocks carved out so far
+    uint64_t root;                       // Offset of the root node, 0 for an empty tree
+    uint64_t size;                       // Number of keys
+    uint64_t global_epoch;               // Advanced by every update
+    uint64_t retired;                    // Blocks unlinked by updates, maybe still being read
+    uint64_t recoveries;                 // Times the allocator was rebuilt after a crash
+    uint64_t free_lists[RADIX_SHM_CLASSES];
+    pthread_mutex_t writer;              // Robust and process-shared
+    RadixShmReader readers[RADIX_SHM_READERS];
+} RadixShmHeader;
+
+// One process's (or thread's) view of a segment
+typedef struct {
+    char *base;                          // Where the segment is mapped in this process
+    RadixShmHeader *header;
+    size_t size;
+    int fd;
+    int slot;                            // Epoch slot owned by this handle
+} RadixShm;
+
+// Nodes made and unlinked by one update, kept until it is published or undone
+typedef struct {
+    uint64_t fresh[RADIX_SHM_MAX_WRITE];
+    int num_fresh;
+    uint64_t unlinked[RADIX_SHM_MAX_WRITE];
+    int num_unlinked;
+    bool failed;
+} RadixShmWrite;
+
+// Function declarations
+RadixShm* radix_shm_create(const char *name, size_t size);
+RadixShm* radix_shm_open(const char *name);
+RadixShm* radix_shm_from_fd(int fd);
+void radix_shm_close(RadixShm *shm);
+int radix_shm_unlink(const char *name);
+int radix_shm_insert(RadixShm *shm, const char *key, uint64_t value);
+int radix_shm_delete(RadixShm *shm, const char *key);
+int radix_shm_search(RadixShm *shm, const char *key, uint64_t *value);
+void radix_shm_traverse(RadixShm *shm, void (*callback)(const char*, uint64_t));
+uint64_t radix_shm_size(RadixShm *shm);
+
+// Helper functions
+static int find_common_prefix_length(const char *str1, int len1, const char *str2);
+static RadixShm* radix_shm_map(int fd, size_t size, bool init);
+static bool radix_shm_lock(RadixShm *shm);
+static void radix_shm_unlock(RadixShm *shm);
+static void radix_shm_recover(RadixShm *shm);
+static uint64_t radix_shm_alloc(RadixShm *shm, size_t size);
+static void radix_shm_free(RadixShm *shm, uint64_t offset);
+static void radix_shm_reclaim(RadixShm *shm);
+static uint64_t radix_shm_insert_recursive(RadixShm *shm, RadixShmWrite *write, uint64_t node_off,
+                                           const char *key, uint64_t value, int *inserted);
+static uint64_t radix_shm_delete_recursive(RadixShm *shm, RadixShmWrite *write, uint64_t node_off,
+                                           const char *key, int *deleted);
+static void radix_shm_traverse_recursive(RadixShm *shm, uint64_t node_off, char *prefix, int prefix_len,
+                                         void (*callback)(const char*, uint64_t));
+
+static inline RadixShmNode* radix_shm_node(RadixShm *shm, uint64_t offset) {
+    return (RadixShmNode*)(shm->base + offset);
+}
+
+static inline char* radix_shm_node_key(RadixShmNode *node) {
+    return (char*)(node + 1);
+}
+
+static inline RadixShmBlock* radix_shm_block(RadixShm *shm, uint64_t offset) {
+    return (RadixShmBlock*)(shm->base + offset - sizeof(RadixShmBlock));
+}
+
+static int find_common_prefix_length(const char *str1, int len1, const char *str2) {
+    int i = 0;
+    while (i < len1 && str2[i] && str1[i] == str2[i]) {
+        i++;
+    }
+    return i;
+}
+
+// Create a tree in a new segment of size bytes. name is a POSIX shared
+// memory name such as "/radixtree", or NULL for an anonymous memfd that
+// other processes reach through radix_shm_from_fd, after fork or by fd
+// passing. The segment does not grow.
+RadixShm* radix_shm_create(const char *name, size_t size) {
+    if (size < sizeof(RadixShmHeader) + 64 * 1024) return NULL;
+    
+    int fd = name ? shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600) : memfd_create("radixtree", 0);
+    if (fd < 0) return NULL;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        if (name) shm_unlink(name);
+        return NULL;
+    }
+    
+    RadixShm *shm = radix_shm_map(fd, size, true);
+    if (!shm) {
+        close(fd);
+        if (name) shm_unlink(name);
+    }
+    return shm;
+}
+
+// Attach to a tree created under a POSIX shared memory name
+RadixShm* radix_shm_open(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return NULL;
+    
+    RadixShm *shm = radix_shm_from_fd(fd);
+    if (!shm) close(fd);
+    return shm;
+}
+
+// Attach to a tree through a descriptor of its segment. The handle takes
+// over fd. Each process, and each thread using the tree, needs its own handle.
+RadixShm* radix_shm_from_fd(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RadixShmHeader)) return NULL;
+    
+    return radix_shm_map(fd, st.st_size, false);
+}
+
+// Map a segment and claim an epoch slot, setting the segment up first if init
+static RadixShm* radix_shm_map(int fd, size_t size, bool init) {
+    char *base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return NULL;
+    
+    RadixShmHeader *header = (RadixShmHeader*)base;
+    if (init) {
+        memset(header, 0, sizeof(RadixShmHeader));
+        header->segment_size = size;
+        header->heap_start = (sizeof(RadixShmHeader) + RADIX_SHM_ALIGN - 1) / RADIX_SHM_ALIGN * RADIX_SHM_ALIGN;
+        header->brk = header->heap_start;
+        header->global_epoch = 1;
+        
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&header->writer, &attr);
+        pthread_mutexattr_destroy(&attr);
+        
+        __atomic_store_n(&header->magic, RADIX_SHM_MAGIC, __ATOMIC_RELEASE);
+    } else if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != RADIX_SHM_MAGIC ||
+               header->segment_size != size) {
+        munmap(base, size);
+        return NULL;
+    }
+    
+    // Take a free slot, or one left behind by a process that died
+    int32_t pid = getpid();
+    int slot = -1;
+    for (int i = 0; i < RADIX_SHM_READERS && slot < 0; i++) {
+        int32_t owner = __atomic_load_n(&header->readers[i].pid, __ATOMIC_ACQUIRE);
+        if (owner != 0 && (kill(owner, 0) == 0 || errno != ESRCH)) continue;
+        if (__atomic_compare_exchange_n(&header->readers[i].pid, &owner, pid, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            __atomic_store_n(&header->readers[i].epoch, 0, __ATOMIC_SEQ_CST);
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        munmap(base, size);
+        return NULL;
+    }
+    
+    RadixShm *shm = (RadixShm*)malloc(sizeof(RadixShm));
+    if (!shm) {
+        __atomic_store_n(&header->readers[slot].pid, 0, __ATOMIC_RELEASE);
+        munmap(base, size);
+        return NULL;
+    }
+    shm->base = base;
+    shm->header = header;
+    shm->size = size;
+    shm->fd = fd;
+    shm->slot = slot;
+    return shm;
+}
+
+// Detach from the segment. The tree stays for the other handles.
+void radix_shm_close(RadixShm *shm) {
+    if (!shm) return;
+    
+    __atomic_store_n(&shm->header->readers[shm->slot].epoch, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&shm->header->readers[shm->slot].pid, 0, __ATOMIC_RELEASE);
+    munmap(shm->base, shm->size);
+    close(shm->fd);
+    free(shm);
+}
+
+// Remove a named segment, which goes away once every handle is closed
+int radix_shm_unlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+// Number of keys in the tree
+uint64_t radix_shm_size(RadixShm *shm) {
+    return shm ? __atomic_load_n(&shm->header->size, __ATOMIC_ACQUIRE) : 0;
+}
+
+// Begin a read. Nodes retired from now on are kept until the read ends.
+static void radix_shm_enter(RadixShm *shm) {
+    uint64_t epoch = __atomic_load_n(&shm->header->global_epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&shm->header->readers[shm->slot].epoch, epoch, __ATOMIC_SEQ_CST);
+}
+
+static void radix_shm_exit(RadixShm *shm) {
+    __atomic_store_n(&shm->header->readers[shm->slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+// Epoch of the oldest read in progress, freeing the slots of dead processes
+static uint64_t radix_shm_oldest_reader(RadixShm *shm) {
+    RadixShmHeader *header = shm->header;
+    uint64_t oldest = UINT64_MAX;
+    
+    for (int i = 0; i < RADIX_SHM_READERS; i++) {
+        RadixShmReader *reader = &header->readers[i];
+        uint64_t epoch = __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST);
+        if (epoch == 0 || epoch >= oldest) continue;
+        
+        int32_t pid = __atomic_load_n(&reader->pid, __ATOMIC_ACQUIRE);
+        if (pid != 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+            // Died in the middle of a read
+            __atomic_store_n(&reader->epoch, 0, __ATOMIC_SEQ_CST);
+            __atomic_compare_exchange_n(&reader->pid, &pid, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        oldest = epoch;
+    }
+    return oldest;
+}
+
+// Take the writer mutex, recovering the segment if its last owner died
+static bool radix_shm_lock(RadixShm *shm) {
+    int err = pthread_mutex_lock(&shm->header->writer);
+    if (err == EOWNERDEAD) {
+        radix_shm_recover(shm);
+        pthread_mutex_consistent(&shm->header->writer);
+        err = 0;
+    }
+    return err == 0;
+}
+
+static void radix_shm_unlock(RadixShm *shm) {
+    pthread_mutex_unlock(&shm->header->writer);
+}
+
+// Size class of a block size, which is a multiple of RADIX_SHM_ALIGN
+static inline int radix_shm_class(uint32_t size) {
+    return size / RADIX_SHM_ALIGN;
+}
+
+// Allocate size bytes in the segment. Only called with the writer mutex held.
+// Returns the offset of the memory, or 0 if the segment is full.
+static uint64_t radix_shm_alloc(RadixShm *shm, size_t size) {
+    RadixShmHeader *header = shm->header;
+    uint32_t block_size = (sizeof(RadixShmBlock) + size + RADIX_SHM_ALIGN - 1) / RADIX_SHM_ALIGN * RADIX_SHM_ALIGN;
+    int size_class = radix_shm_class(block_size);
+    if (size_class >= RADIX_SHM_CLASSES) return 0;
+    
+    uint64_t block_off = header->free_lists[size_class];
+    if (block_off) {
+        RadixShmBlock *block = (RadixShmBlock*)(shm->base + block_off);
+        header->free_lists[size_class] = block->next;
+        block->state = RADIX_SHM_USED;
+        return block_off + sizeof(RadixShmBlock);
+    }
+    
+    block_off = header->brk;
+    if (block_off + block_size > header->segment_size) return 0;
+    
+    // The header is complete before brk moves past it, so the heap can always be walked
+    RadixShmBlock *block = (RadixShmBlock*)(shm->base + block_off);
+    block->size = block_size;
+    block->state = RADIX_SHM_USED;
+    block->next = 0;
+    block->epoch = 0;
+    block->mark = 0;
+    __atomic_store_n(&header->brk, block_off + block_size, __ATOMIC_RELEASE);
+    return block_off + sizeof(RadixShmBlock);
+}
+
+// Put a block on its free list. Only called with the writer mutex held.
+static void radix_shm_free(RadixShm *shm, uint64_t offset) {
+    RadixShmBlock *block = radix_shm_block(shm, offset);
+    int size_class = radix_shm_class(block->size);
+    
+    block->state = RADIX_SHM_FREE;
+    block->next = shm->header->free_lists[size_class];
+    shm->header->free_lists[size_class] = offset - sizeof(RadixShmBlock);
+}
+
+// Free the retired blocks that no read in progress can still reach
+static void radix_shm_reclaim(RadixShm *shm) {
+    RadixShmHeader *header = shm->header;
+    if (!header->retired) return;
+    
+    uint64_t oldest = radix_shm_oldest_reader(shm);
+    uint64_t *link = &header->retired;
+    while (*link) {
+        RadixShmBlock *block = (RadixShmBlock*)(shm->base + *link);
+        if (block->epoch < oldest) {
+            uint64_t block_off = *link;
+            *link = block->next;
+            radix_shm_free(shm, block_off + sizeof(RadixShmBlock));
+        } else {
+            link = &block->next;
+        }
+    }
+}
+
+// Mark the nodes reachable from node_off, returning the keys below it
+static uint64_t radix_shm_mark(RadixShm *shm, uint64_t node_off, uint64_t mark) {
+    if (!node_off) return 0;
+    
+    radix_shm_block(shm, node_off)->mark = mark;
+    RadixShmNode *node = radix_shm_node(shm, node_off);
+    uint64_t count = node->is_terminal ? 1 : 0;
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        count += radix_shm_mark(shm, node->children[i], mark);
+    }
+    return count;
+}
+
+// Rebuild the allocator after a writer died holding the mutex. The
+// published tree is consistent, but free lists, the retired list and the
+// key count may have been caught halfway through an update.
+static void radix_shm_recover(RadixShm *shm) {
+    RadixShmHeader *header = shm->header;
+    uint64_t epoch = __atomic_add_fetch(&header->global_epoch, 1, __ATOMIC_SEQ_CST);
+    
+    // Wait out the reads that began before now, which may still be on
+    // nodes the dead writer unlinked but did not retire
+    while (radix_shm_oldest_reader(shm) < epoch) {
+        sched_yield();
+    }
+    
+    uint64_t root = __atomic_load_n(&header->root, __ATOMIC_ACQUIRE);
+    header->size = radix_shm_mark(shm, root, epoch);
+    
+    // Everything the tree does not reach is free
+    memset(header->free_lists, 0, sizeof(header->free_lists));
+    header->retired = 0;
+    for (uint64_t block_off = header->heap_start; block_off < header->brk; ) {
+        RadixShmBlock *block = (RadixShmBlock*)(shm->base + block_off);
+        if (block->mark != epoch) {
+            radix_shm_free(shm, block_off + sizeof(RadixShmBlock));
+        }
+        block_off += block->size;
+    }
+    header->recoveries++;
+}
+
+// Allocate a node for the current update, copying value and children from
+// src_off unless it is 0
+static uint64_t radix_shm_node_create(RadixShm *shm, RadixShmWrite *write, uint64_t src_off,
+                                      const char *key, int key_len) {
+    if (write->failed) return 0;
+    
+    uint64_t node_off = radix_shm_alloc(shm, sizeof(RadixShmNode) + key_len + 1);
+    if (!node_off) {
+        write->failed = true;
+        return 0;
+    }
+    write->fresh[write->num_fresh++] = node_off;
+    
+    RadixShmNode *node = radix_shm_node(shm, node_off);
+    if (src_off) {
+        memcpy(node, radix_shm_node(shm, src_off), sizeof(RadixShmNode));
+    } else {
+        memset(node, 0, sizeof(RadixShmNode));
+    }
+    node->key_len = key_len;
+    memcpy(radix_shm_node_key(node), key, key_len);
+    radix_shm_node_key(node)[key_len] = '\0';
+    return node_off;
+}
+
+// Drop a node from the tree being built. Published nodes are retired once
+// the update is published, while nodes of this update are freed at once.
+static void radix_shm_node_unlink(RadixShm *shm, RadixShmWrite *write, uint64_t node_off) {
+    for (int i = 0; i < write->num_fresh; i++) {
+        if (write->fresh[i] == node_off) {
+            write->fresh[i] = write->fresh[--write->num_fresh];
+            radix_shm_free(shm, node_off);
+            return;
+        }
+    }
+    write->unlinked[write->num_unlinked++] = node_off;
+}
+
+// Replace a node that has exactly one child by a merge of the two
+static uint64_t radix_shm_merge_child(RadixShm *shm, RadixShmWrite *write, uint64_t node_off) {
+    RadixShmNode *node = radix_shm_node(shm, node_off);
+    uint64_t child_off = 0;
+    for (int i = 0; i < MAX_CHILDREN && !child_off; i++) {
+        child_off = node->children[i];
+    }
+    RadixShmNode *child = radix_shm_node(shm, child_off);
+    
+    char key[MAX_KEY_LENGTH];
+    int key_len = node->key_len + child->key_len;
+    memcpy(key, radix_shm_node_key(node), node->key_len);
+    memcpy(key + node->key_len, radix_shm_node_key(child), child->key_len);
+    
+    uint64_t merged_off = radix_shm_node_create(shm, write, child_off, key, key_len);
+    if (!merged_off) return node_off;
+    
+    radix_shm_node_unlink(shm, write, node_off);
+    radix_shm_node_unlink(shm, write, child_off);
+    return merged_off;
+}
+
+// Undo or publish an update with the writer mutex held
+static void radix_shm_finish(RadixShm *shm, RadixShmWrite *write, uint64_t root, int64_t size_change) {
+    RadixShmHeader *header = shm->header;
+    
+    if (write->failed) {
+        for (int i = 0; i < write->num_fresh; i++) {
+            radix_shm_free(shm, write->fresh[i]);
+        }
+        return;
+    }
+    
+    __atomic_store_n(&header->root, root, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&header->size, header->size + size_change, __ATOMIC_RELEASE);
+    
+    // Readers that started before the new root may still be on the old nodes
+    uint64_t epoch = __atomic_load_n(&header->global_epoch, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < write->num_unlinked; i++) {
+        RadixShmBlock *block = radix_shm_block(shm, write->unlinked[i]);
+        block->state = RADIX_SHM_RETIRED;
+        block->epoch = epoch;
+        block->next = header->retired;
+        header->retired = write->unlinked[i] - sizeof(RadixShmBlock);
+    }
+    __atomic_add_fetch(&header->global_epoch, 1, __ATOMIC_SEQ_CST);
+    
+    radix_shm_reclaim(shm);
+}
+
+// Insert a key-value pair. Returns 1 if the key is new, 0 if it was
+// updated, and -1 if the segment is full.
+int radix_shm_insert(RadixShm *shm, const char *key, uint64_t value) {
+    if (!shm || !key || strlen(key) >= MAX_KEY_LENGTH) return -1;
+    if (!radix_shm_lock(shm)) return -1;
+    
+    RadixShmWrite *write = (RadixShmWrite*)malloc(sizeof(RadixShmWrite));
+    if (!write) {
+        radix_shm_unlock(shm);
+        return -1;
+    }
+    write->num_fresh = 0;
+    write->num_unlinked = 0;
+    write->failed = false;
+    
+    int inserted = 0;
+    uint64_t root = radix_shm_insert_recursive(shm, write, shm->header->root, key, value, &inserted);
+    radix_shm_finish(shm, write, root, inserted);
+    
+    int result = write->failed ? -1 : inserted;
+    free(write);
+    radix_shm_unlock(shm);
+    return result;
+}
+
+// Recursive helper for insertion. Returns the node that replaces node_off,
+// made of copies wherever something below changed.
+static uint64_t radix_shm_insert_recursive(RadixShm *shm, RadixShmWrite *write, uint64_t node_off,
+                                           const char *key, uint64_t value, int *inserted) {
+    if (!node_off) {
+        uint64_t leaf_off = radix_shm_node_create(shm, write, 0, key, strlen(key));
+        if (!leaf_off) return 0;
+        
+        RadixShmNode *leaf = radix_shm_node(shm, leaf_off);
+        leaf->is_terminal = true;
+        leaf->value = value;
+        *inserted = 1;
+        return leaf_off;
+    }
+    
+    RadixShmNode *node = radix_shm_node(shm, node_off);
+    const char *node_key = radix_shm_node_key(node);
+    int node_key_len = node->key_len;
+    int common_len = find_common_prefix_length(node_key, node_key_len, key);
+    
+    if (common_len == node_key_len) {
+        uint64_t copy_off = radix_shm_node_create(shm, write, node_off, node_key, node_key_len);
+        if (!copy_off) return node_off;
+        RadixShmNode *copy = radix_shm_node(shm, copy_off);
+        
+        if (key[common_len] == '\0') {
+            // Exact match - update value
+            if (!copy->is_terminal) {
+                copy->is_terminal = true;
+                *inserted = 1;
+            }
+            copy->value = value;
+        } else {
+            unsigned char first_char = (unsigned char)key[common_len];
+            uint64_t old_child = copy->children[first_char];
+            uint64_t new_child = radix_shm_insert_recursive(shm, write, old_child, key + common_len, value, inserted);
+            if (write->failed) return node_off;
+            
+            copy->children[first_char] = new_child;
+            if (!old_child) {
+                copy->num_children++;
+            }
+        }
+        
+        radix_shm_node_unlink(shm, write, node_off);
+        return copy_off;
+    }
+    
+    // Split: a new parent holds the shared part, a copy of the node the rest
+    uint64_t parent_off = radix_shm_node_create(shm, write, 0, key, common_len);
+    uint64_t rest_off = radix_shm_node_create(shm, write, node_off, node_key + common_len, node_key_len - common_len);
+    if (write->failed) return node_off;
+    
+    RadixShmNode *parent = radix_shm_node(shm, parent_off);
+    parent->children[(unsigned char)node_key[common_len]] = rest_off;
+    parent->num_children = 1;
+    
+    if (key[common_len] == '\0') {
+        parent->is_terminal = true;
+        parent->value = value;
+        *inserted = 1;
+    } else {
+        uint64_t leaf_off = radix_shm_insert_recursive(shm, write, 0, key + common_len, value, inserted);
+        if (write->failed) return node_off;
+        
+        parent->children[(unsigned char)key[common_len]] = leaf_off;
+        parent->num_children = 2;
+    }
+    
+    radix_shm_node_unlink(shm, write, node_off);
+    return parent_off;
+}
+
+// Delete a key. Returns 1 if it was present, 0 if not, and -1 if the
+// segment had no room for the copies.
+int radix_shm_delete(RadixShm *shm, const char *key) {
+    if (!shm || !key) return 0;
+    if (!radix_shm_lock(shm)) return -1;
+    
+    RadixShmWrite *write = (RadixShmWrite*)malloc(sizeof(RadixShmWrite));
+    if (!write) {
+        radix_shm_unlock(shm);
+        return -1;
+    }
+    write->num_fresh = 0;
+    write->num_unlinked = 0;
+    write->failed = false;
+    
+    int deleted = 0;
+    uint64_t root = radix_shm_delete_recursive(shm, write, shm->header->root, key, &deleted);
+    if (deleted) {
+        radix_shm_finish(shm, write, root, -1);
+    }
+    
+    int result = write->failed ? -1 : deleted;
+    free(write);
+    radix_shm_unlock(shm);
+    return result;
+}
+
+// Recursive helper for deletion. Nothing is copied unless the key is found.
+static uint64_t radix_shm_delete_recursive(RadixShm *shm, RadixShmWrite *write, uint64_t node_off,
+                                           const char *key, int *deleted) {
+    if (!node_off) return 0;
+    
+    RadixShmNode *node = radix_shm_node(shm, node_off);
+    const char *node_key = radix_shm_node_key(node);
+    int node_key_len = node->key_len;
+    int common_len = find_common_prefix_length(node_key, node_key_len, key);
+    if (common_len < node_key_len) return node_off;
+    
+    if (key[common_len] == '\0') {
+        // Found the node to delete
+        if (!node->is_terminal) return node_off;
+        *deleted = 1;
+        
+        if (node->num_children == 0) {
+            radix_shm_node_unlink(shm, write, node_off);
+            return 0;
+        }
+        if (node->num_children == 1) {
+            return radix_shm_merge_child(shm, write, node_off);
+        }
+        
+        uint64_t copy_off = radix_shm_node_create(shm, write, node_off, node_key, node_key_len);
+        if (!copy_off) return node_off;
+        radix_shm_node(shm, copy_off)->is_terminal = false;
+        radix_shm_node(shm, copy_off)->value = 0;
+        radix_shm_node_unlink(shm, write, node_off);
+        return copy_off;
+    }
+    
+    // Continue deletion in subtree
+    unsigned char first_char = (unsigned char)key[common_len];
+    uint64_t old_child = node->children[first_char];
+    uint64_t new_child = radix_shm_delete_recursive(shm, write, old_child, key + common_len, deleted);
+    if (!*deleted || write->failed) return node_off;
+    
+    uint64_t copy_off = radix_shm_node_create(shm, write, node_off, node_key, node_key_len);
+    if (!copy_off) return node_off;
+    RadixShmNode *copy = radix_shm_node(shm, copy_off);
+    copy->children[first_char] = new_child;
+    if (!new_child) {
+        copy->num_children--;
+    }
+    radix_shm_node_unlink(shm, write, node_off);
+    
+    // Check if current node can be merged or removed
+    if (!copy->is_terminal && copy->num_children == 0) {
+        radix_shm_node_unlink(shm, write, copy_off);
+        return 0;
+    }
+    if (!copy->is_terminal && copy->num_children == 1) {
+        return radix_shm_merge_child(shm, write, copy_off);
+    }
+    return copy_off;
+}
+
+// Search for a key without locking. Returns 1 and sets *value if found.
+int radix_shm_search(RadixShm *shm, const char *key, uint64_t *value) {
+    if (!shm || !key) return 0;
+    
+    radix_shm_enter(shm);
+    
+    int found = 0;
+    uint64_t node_off = __atomic_load_n(&shm->header->root, __ATOMIC_SEQ_CST);
+    while (node_off) {
+        RadixShmNode *node = radix_shm_node(shm, node_off);
+        int node_key_len = node->key_len;
+        if (strncmp(radix_shm_node_key(node), key, node_key_len) != 0) break;
+        
+        key += node_key_len;
+        if (key[0] == '\0') {
+            if (node->is_terminal) {
+                if (value) *value = node->value;
+                found = 1;
+            }
+            break;
+        }
+        node_off = node->children[(unsigned char)key[0]];
+    }
+    
+    radix_shm_exit(shm);
+    return found;
+}
+
+// Traverse the tree as of the moment the call starts, without locking
+void radix_shm_traverse(RadixShm *shm, void (*callback)(const char*, uint64_t)) {
+    if (!shm || !callback) return;
+    
+    radix_shm_enter(shm);
+    char prefix[MAX_KEY_LENGTH];
+    radix_shm_traverse_recursive(shm, __atomic_load_n(&shm->header->root, __ATOMIC_SEQ_CST), prefix, 0, callback);
+    radix_shm_exit(shm);
+}
+
+// Recursive helper for traversal
+static void radix_shm_traverse_recursive(RadixShm *shm, uint64_t node_off, char *prefix, int prefix_len,
+                                         void (*callback)(const char*, uint64_t)) {
+    if (!node_off) return;
+    
+    RadixShmNode *node = radix_shm_node(shm, node_off);
+    memcpy(prefix + prefix_len, radix_shm_node_key(node), node->key_len + 1);
+    int new_prefix_len = prefix_len + node->key_len;
+    
+    if (node->is_terminal) {
+        callback(prefix, node->value);
+    }
+    
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        if (node->children[i]) {
+            radix_shm_traverse_recursive(shm, node->children[i], prefix, new_prefix_len, callback);
+        }
+    }
+}
+
+void print_key_value(const char *key, uint64_t value) {
+    printf("Key: '%s', Value: %llu\n", key, (unsigned long long)value);
+}
+
+void print_after_key(const char *key, uint64_t value) {
+    if (strncmp(key, "after", 5) == 0) {
+        print_key_value(key, value);
+    }
+}
+
+// Example usage: worker processes sharing one tree
+int main() {
+    const int num_workers = 4;
+    const int keys_per_worker = 500;
+    
+    printf("=== Shared Memory Radix Tree Test ===\n\n");
+    
+    RadixShm *shm = radix_shm_create(NULL, 64 * 1024 * 1024);
+    if (!shm) {
+        printf("Could not create the segment\n");
+        return 1;
+    }
+    
+    // Each worker inserts its own keys and reads everyone's
+    fflush(stdout);
+    for (int w = 0; w < num_workers; w++) {
+        if (fork() == 0) {
+            RadixShm *own = radix_shm_from_fd(dup(shm->fd));
+            char key[64];
+            int seen = 0;
+            for (int i = 0; i < keys_per_worker; i++) {
+                snprintf(key, sizeof(key), "worker%d/key%04d", w, i);
+                radix_shm_insert(own, key, w * 10000 + i);
+                
+                snprintf(key, sizeof(key), "worker%d/key%04d", (w + 1) % num_workers, i);
+                seen += radix_shm_search(own, key, NULL);
+            }
+            printf("Worker %d inserted %d keys, saw %d of its neighbour's\n", w, keys_per_worker, seen);
+            radix_shm_close(own);
+            fflush(stdout);
+            _exit(0);
+        }
+    }
+    for (int w = 0; w < num_workers; w++) {
+        wait(NULL);
+    }
+    printf("Keys after workers: %llu\n\n", (unsigned long long)radix_shm_size(shm));
+    
+    // A writer dies in the middle of an update
+    fflush(stdout);
+    if (fork() == 0) {
+        RadixShm *own = radix_shm_from_fd(dup(shm->fd));
+        radix_shm_lock(own);
+        radix_shm_alloc(own, sizeof(RadixShmNode));
+        kill(getpid(), SIGKILL);
+    }
+    wait(NULL);
+    
+    // The next writer finds the mutex abandoned and recovers
+    radix_shm_delete(shm, "worker0/key0000");
+    radix_shm_insert(shm, "after/crash", 42);
+    printf("Recoveries: %llu, keys: %llu\n", (unsigned long long)shm->header->recoveries,
+           (unsigned long long)radix_shm_size(shm));
+    
+    uint64_t value = 0;
+    int found = radix_shm_search(shm, "worker3/key0499", &value);
+    printf("Search 'worker3/key0499': %s (value: %llu)\n", found ? "FOUND" : "NOT FOUND", (unsigned long long)value);
+    printf("Search 'worker0/key0000': %s\n\n", radix_shm_search(shm, "worker0/key0000", NULL) ? "FOUND" : "NOT FOUND");
+    
+    printf("Keys under 'after':\n");
+    radix_shm_insert(shm, "after/recovery", 43);
+    radix_shm_delete(shm, "after/recovery");
+    radix_shm_traverse(shm, print_after_key);
+    
+    radix_shm_close(shm);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include "radixtree.hpp"
+
+// Same keys as the radixtree.cpp demo, stored with a 16-way node layout
+struct NibbleTraits : radix::DefaultTraits<std::string> {
+    using Alphabet = radix::NibbleAlphabet;
+};
+
+// Example usage and test function
+int main() {
+    const char *keys[] = {"hello", "help", "hell", "world", "word", "work", "test", "testing", "tea", "team"};
+    int num_keys = sizeof(keys) / sizeof(keys[0]);
+
+    printf("=== Radix Tree Template Test ===\n\n");
+
+    // Values stored inline in the nodes
+    radix::RadixTree<std::string, int> tree;
+    printf("Inserting keys:\n");
+    for (int i = 0; i < num_keys; i++) {
+        bool result = tree.insert(keys[i], i + 1);
+        printf("Insert '%s': %s\n", keys[i], result ? "SUCCESS" : "FAILED");
+    }
+    printf("\n");
+
+    printf("Searching for keys:\n");
+    for (int i = 0; i < num_keys; i++) {
+        int *result = tree.find(keys[i]);
+        if (result) {
+            printf("Search '%s': FOUND (value: %d)\n", keys[i], *result);
+        } else {
+            printf("Search '%s': NOT FOUND\n", keys[i]);
+        }
+    }
+    printf("Search 'nonexistent': %s\n", tree.contains("nonexistent") ? "FOUND" : "NOT FOUND");
+    printf("\n");
+
+    printf("Deleting keys:\n");
+    const char *keys_to_delete[] = {"help", "test", "word"};
+    for (const char *key : keys_to_delete) {
+        printf("Delete '%s': %s\n", key, tree.erase(key) ? "SUCCESS" : "FAILED");
+    }
+    printf("\n");
+
+    printf("Tree traversal (size: %zu):\n", tree.size());
+    tree.for_each([](const std::string &key, int value) {
+        printf("Key: '%s', Value: %d\n", key.c_str(), value);
+    });
+    printf("\n");
+
+    // Move-only values with 16-way nodes
+    radix::RadixTree<std::string, std::unique_ptr<std::string>, NibbleTraits> owned;
+    for (int i = 0; i < num_keys; i++) {
+        owned.insert(keys[i], std::make_unique<std::string>(std::string(keys[i]) + "!"));
+    }
+    owned.erase("hell");
+
+    printf("Nibble tree traversal (size: %zu):\n", owned.size());
+    owned.for_each([](const std::string &key, std::unique_ptr<std::string> &value) {
+        printf("Key: '%s', Value: '%s'\n", key.c_str(), value->c_str());
+    });
+    printf("\n");
+
+    // Ordered integer index over fixed-width keys
+    radix::RadixTree<radix::FixedKey<8>, int, radix::FixedKeyTraits<8>> index;
+    long long numbers[] = {42, -7, 1000, 0, -1000, 17, 256, -1};
+    for (long long number : numbers) {
+        index.insert(radix::make_key((int64_t)number), (int)number);
+    }
+
+    printf("Integer keys in [-10, 300]:\n");
+    index.scan_range(radix::make_key((int64_t)-10), radix::make_key((int64_t)300),
+                     [](const radix::FixedKey<8> &key, int value) {
+        printf("Key: %lld, Value: %d\n", (long long)radix::key_field<int64_t>(key), value);
+    });
+
+    return 0;
+}